@@ -17,15 +17,47 @@ INCLUDEPATH += \
     headers/
 
 SOURCES += \
+    sources/cachedpdfview.cpp \
+    sources/compactwriter.cpp \
+    sources/editjournal.cpp \
+    sources/editmodel.cpp \
+    sources/fontmetricscache.cpp \
+    sources/fontresolver.cpp \
+    sources/imagedownsampler.cpp \
+    sources/incrementalwriter.cpp \
+    sources/linearizedwriter.cpp \
     sources/main.cpp \
     sources/mainwindow.cpp \
+    sources/pageimagecache.cpp \
     sources/pageselector.cpp \
+    sources/pagetilecache.cpp \
+    sources/pdfeditview.cpp \
+    sources/pdfpagewidget.cpp \
+    sources/qiodevicestream.cpp \
+    sources/streamdeduplicator.cpp \
+    sources/thumbnailmodel.cpp \
     sources/tools.cpp \
     sources/zoomselector.cpp
 
 HEADERS += \
+    headers/cachedpdfview.h \
+    headers/compactwriter.h \
+    headers/editjournal.h \
+    headers/editmodel.h \
+    headers/fontmetricscache.h \
+    headers/fontresolver.h \
+    headers/imagedownsampler.h \
+    headers/incrementalwriter.h \
+    headers/linearizedwriter.h \
     headers/mainwindow.h \
+    headers/pageimagecache.h \
     headers/pageselector.h \
+    headers/pagetilecache.h \
+    headers/pdfeditview.h \
+    headers/pdfpagewidget.h \
+    headers/qiodevicestream.h \
+    headers/streamdeduplicator.h \
+    headers/thumbnailmodel.h \
     headers/tools.h \
     headers/zoomselector.h
 
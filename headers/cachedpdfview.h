@@ -0,0 +1,74 @@
+#ifndef CACHEDPDFVIEW_H
+#define CACHEDPDFVIEW_H
+
+#include <QHash>
+#include <QPdfView>
+#include <QRect>
+#include <QSizeF>
+#include <QTimer>
+#include <QVector>
+
+class QPdfDocument;
+class PageImageCache;
+
+// 阅读模式的视图：布局和滚动沿用 QPdfView，页面图片改从 PageImageCache 获取
+// QPdfView 缩放后会丢弃全部渲染结果，且只保留少量页面，来回滚动时反复渲染
+// 缩放后先把其他缩放下缓存的图片缩放绘制，完整分辨率的图片在后台渲染，完成后替换
+// 绘制后按翻页或滚动的方向预先渲染前方的几页和后方的一页，翻页时不需要等待
+// 连续的缩放（连续点击、Ctrl+滚轮）每帧只应用一次，应用后立即按新的缩放渲染，旧缩放下尚未开始的渲染作废
+// 页面尺寸在文档加载后读取一次，布局只在缩放、视口大小、页面模式等改变时重新计算
+class CachedPdfView : public QPdfView
+{
+    Q_OBJECT
+
+public:
+    explicit CachedPdfView(QWidget *parent = nullptr);
+
+    // 未设置缓存时按 QPdfView 原来的方式绘制
+    void setPageCache(PageImageCache *pageCache);
+    PageImageCache* pageCache() const { return m_pageCache; }
+
+    // 与 QPdfView 相同的布局：各页在文档中的位置（单位：px），单页模式只有当前页
+    const QHash<int, QRect>& pageGeometries() const;
+    // 按当前缩放，页面渲染后的大小（单位：px）
+    QSize scaledPageSize(int page) const;
+
+    // 一帧内的多次缩放合并为一次，基于 pendingZoomFactor() 连续缩放不会丢失中间的倍数
+    void requestZoomFactor(qreal factor);
+    qreal pendingZoomFactor() const;
+
+    // 预先渲染的页数：移动方向上的页数和反方向上的页数
+    static const int PREFETCH_AHEAD = 3;
+    static const int PREFETCH_BEHIND = 1;
+    // 合并缩放的间隔（一帧）
+    static const int ZOOM_COALESCE_MS = 16;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    bool viewportEvent(QEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+private slots:
+    void onPageReady(int page);
+    void onZoomChanged();
+    void onDocumentChanged(QPdfDocument *document);
+    void onDocumentStatusChanged();
+    void invalidateLayout();
+
+private:
+    void prefetch(int firstPage, int lastPage);
+    // 文档加载后缓存的页面尺寸（单位：pt），QPdfDocument::pageSize() 每次都要获取 pdfium 的全局锁
+    QSizeF pointSize(int page) const { return m_pointSizes.value(page); }
+
+    PageImageCache *m_pageCache;
+    // 单页模式为当前页，连续模式为滚动位置，变化的符号即移动方向
+    int m_lastAnchor;
+    int m_direction;
+    qreal m_pendingZoomFactor;
+    QTimer m_zoomTimer;
+    QVector<QSizeF> m_pointSizes;
+    mutable QHash<int, QRect> m_geometries;
+    mutable bool m_layoutValid;
+};
+
+#endif // CACHEDPDFVIEW_H
@@ -0,0 +1,39 @@
+#ifndef COMPACTWRITER_H
+#define COMPACTWRITER_H
+
+#include <podofo/podofo.h>
+
+// 以紧凑格式完整重写文档：不含流的对象打包进对象流（/Type /ObjStm），
+// 交叉引用表写为交叉引用流（/Type /XRef），两者都用 FlateDecode 压缩
+// 对象按引用关系重新编号，输出只取决于文档的内容，与对象原来的编号和修改历史无关
+// 需要 PDF 1.5，版本更低的文档会升级到 1.5；不支持加密的文档
+class CompactWriter
+{
+public:
+    explicit CompactWriter(PoDoFo::PdfDocument &document);
+
+    // 对象流和交叉引用流的压缩级别：0 ~ 9，-1 为 zlib 默认级别
+    void setCompressionLevel(int level) { m_compressionLevel = level; }
+
+    // 文件标识符（/ID）取写入内容的摘要，而不是沿用文档中的标识符，相同的内容写出相同的字节
+    void setDeterministicId(bool deterministic) { m_deterministicId = deterministic; }
+
+    // 不可达的对象不会写入，失败时抛出 PdfError
+    void write(PoDoFo::OutputStreamDevice &device);
+
+    // 打包进对象流的对象数和对象流数，write() 之后有效
+    int packedObjectCount() const { return m_packedObjectCount; }
+    int objectStreamCount() const { return m_objectStreamCount; }
+
+    // 每个对象流最多容纳的对象数
+    static const int OBJECTS_PER_STREAM = 100;
+
+private:
+    PoDoFo::PdfDocument &m_document;
+    int m_compressionLevel;
+    bool m_deterministicId;
+    int m_packedObjectCount;
+    int m_objectStreamCount;
+};
+
+#endif // COMPACTWRITER_H
@@ -0,0 +1,56 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QTimer>
+
+class EditModel;
+
+// 编辑日志：把每次修改后文本的状态追加到文档旁的日志文件（<文件名>.journal）
+// 写入先缓存，定时或缓存过大时一起写入并同步到磁盘，程序崩溃时最多丢失最后一批修改
+// 重新打开文档时按日志恢复修改，日志记录了原文件的大小和修改时间，原文件变化后日志作废
+class EditJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EditJournal(EditModel *model, QObject *parent = nullptr);
+    ~EditJournal();
+
+    static QString journalFileName(const QString &fileName);
+    // 有与原文件匹配、可以恢复的日志
+    static bool isRecoverable(const QString &fileName);
+
+    // 按日志恢复修改（以命令的形式压入撤销栈），返回恢复的文本数
+    // 日志末尾不完整或校验失败的记录（崩溃时写了一半）被忽略
+    int replay();
+
+    // 为模型当前的文档重新开始记录：写入文件头和当前所有修改过的文本
+    // 保存到原文件后也要调用，之前的记录已经写入文件
+    bool start();
+    // 写入缓存的记录并同步到磁盘
+    void flush();
+    // 正常关闭文档时删除日志
+    void stop();
+
+    static const int FLUSH_INTERVAL_MS = 1000;
+    static const int MAX_PENDING_BYTES = 64 * 1024;
+
+private slots:
+    void onRunChanged(int pageIndex, int runIndex);
+
+private:
+    struct Header;
+    static bool readHeader(QFile &file, Header &header);
+    static Header sourceHeader(const QString &fileName);
+    void append(int pageIndex, int runIndex);
+
+    EditModel *m_model;
+    QFile m_file;
+    QByteArray m_pending;
+    QTimer m_flushTimer;
+};
+
+#endif // EDITJOURNAL_H
@@ -0,0 +1,191 @@
+#ifndef EDITMODEL_H
+#define EDITMODEL_H
+
+#include "tools.h"
+
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QRectF>
+#include <QSet>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+
+class QUndoStack;
+
+namespace PoDoFo {
+class PdfMemDocument;
+}
+
+// 一段可编辑的文本
+// original 与 run 共享 QString/QFont 的数据，只有修改过的字段才会复制
+struct EditRun {
+    UPdfTextRun run;
+    UPdfTextRun original;
+    bool dirty = false;     // 与原文件相比有修改（撤销回原样后恢复为 false）
+    quint32 version = 0;    // 每次修改（包括撤销/重做）递增
+};
+
+// (pageIndex, runIndex)
+typedef QPair<int, int> EditRunIndex;
+
+// 编辑模型：持有解析后的 PDF 和每页的文本，与编辑框等控件无关
+// 页面的文本在第一次访问时才提取，修改通过 runChanged 通知视图
+class EditModel : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EditModel(QObject *parent = nullptr);
+    ~EditModel();
+
+    // 解析 PDF，只读取每页的 TrimBox，失败时抛出 PdfError
+    void load(const QString &fileName);
+    void clear();
+    const QString& fileName() const { return m_fileName; }
+    PoDoFo::PdfMemDocument* document() const { return m_document.get(); }
+
+    int pageCount() const { return m_pages.size(); }
+    // PDF 坐标（单位：pt），y 为下边界
+    QRectF pageTrimBox(int pageIndex) const;
+    // 页面的全部文本（包含用户的修改），未提取的页面会先提取
+    const QVector<EditRun>& pageRuns(int pageIndex);
+    const EditRun& run(const EditRunIndex &index) const;
+
+    // 修改以命令的形式压入撤销栈，命令只记录差异
+    // 拖动文本时，同一次拖动（gesture 相同且不为 0）中的连续移动合并为一步，
+    // gesture 为 0 的修改总是单独一步
+    void setText(const EditRunIndex &index, const QString &text);
+    void setPos(const EditRunIndex &index, const QPointF &pos, int gesture = 0);
+    void setFont(const EditRunIndex &index, const QFont &font);
+    // 开始一次拖动，返回新的 gesture
+    int beginGesture();
+    QUndoStack* undoStack() const { return m_undoStack; }
+
+    // 撤销栈的步数上限，超过后丢弃最早的修改
+    static const int UNDO_LIMIT = 1000;
+
+    // 在后台线程以增量更新的方式保存修改过的文本，完成后发出 saveFinished
+    // 只修改了内容的文本直接替换原内容流中的运算对象，其余的叠加绘制
+    // 只修改页面和内容流的副本，内存中的文档不变；另存为不影响之后保存到原文件
+    // 保存到原文件时直接追加增量更新，取消或失败时截断回原来的大小；
+    // 另存为和完整重写先写入临时文件，成功后再替换目标文件
+    // 没有文档或正在保存时返回 false，不会发出 saveFinished
+    bool save(const QString &fileName);
+    // 把所有页面的文本（包含修改）导出为新的 PDF，同样在后台线程进行并发出 saveFinished
+    // 逐页写入文件，内存占用与页数无关
+    bool exportTextLayer(const QString &fileName);
+    void cancelSave();
+    bool isSaving() const { return m_saving; }
+
+    // saveProgress 的最大值
+    static const int SAVE_PROGRESS_MAX = 100;
+
+    // 保存时内容流的压缩级别：0 ~ 9，越大文件越小、保存越慢；-1 为 zlib 默认级别
+    void setCompressionLevel(int level);
+    int compressionLevel() const { return m_compressionLevel; }
+    static const int DEFAULT_COMPRESSION_LEVEL = -1;
+
+    // 紧凑保存：不做增量更新，完整重写文件，不含流的对象打包进对象流，交叉引用写为交叉引用流
+    // 小对象多的文件明显变小，打开也更快；加密的文档保存失败
+    void setCompactSave(bool compact) { m_compactSave = compact; }
+    bool compactSave() const { return m_compactSave; }
+
+    // 优化保存：完整重写文件，合并内容相同的流、字体等对象并删除不可达的对象
+    void setOptimizeSave(bool optimize) { m_optimizeSave = optimize; }
+    bool optimizeSave() const { return m_optimizeSave; }
+    // 上一次保存时各类对象（Image、FontFile、Font 等）和缩小图片节省的字节数，未优化时为空
+    const QMap<QString, qint64>& savedBytes() const { return m_savedBytes; }
+
+    // 可重现保存：不更新修改时间等元数据，以紧凑格式完整重写，对象编号和文件标识符只取决于内容
+    // 相同的原文件和相同的修改得到逐字节相同的文件
+    void setReproducibleSave(bool reproducible) { m_reproducibleSave = reproducible; }
+    bool reproducibleSave() const { return m_reproducibleSave; }
+
+    // 线性化保存（Fast Web View）：完整重写文件，第一页的对象和提示表在文件开头，
+    // 阅读器不需要读完整个文件就能显示第一页；优先于紧凑保存
+    void setLinearizeSave(bool linearize) { m_linearizeSave = linearize; }
+    bool linearizeSave() const { return m_linearizeSave; }
+
+    // 缩小图片：完整重写文件，按页面上的绘制尺寸计算图片的实际分辨率，
+    // 超过目标分辨率的图片缩小并以指定的 JPEG 质量重新编码
+    void setDownsampleImages(bool downsample) { m_downsampleImages = downsample; }
+    bool downsampleImages() const { return m_downsampleImages; }
+    void setImageTargetDpi(int dpi) { m_imageTargetDpi = qMax(1, dpi); }
+    int imageTargetDpi() const { return m_imageTargetDpi; }
+    void setJpegQuality(int quality) { m_jpegQuality = qBound(1, quality, 100); }
+    int jpegQuality() const { return m_jpegQuality; }
+
+    bool isDirty() const { return !m_dirtyRuns.isEmpty(); }
+    // 有修改的文本，按页码、序号排序
+    QVector<EditRunIndex> dirtyRuns() const;
+
+signals:
+    void modelReset();
+    void runChanged(int pageIndex, int runIndex);
+    void saveProgress(int value);
+    // 取消保存时 succeeded 为 false，message 为空
+    void saveFinished(bool succeeded, const QString &message);
+
+private:
+    friend class EditTextCommand;
+    friend class EditPosCommand;
+    friend class EditFontCommand;
+
+    struct Page {
+        QRectF trimBox;
+        bool extracted = false;
+        QVector<EditRun> runs;
+        // 叠加绘制的文本画在页面资源中名为 overlay 的表单中，每次保存重新生成整个表单，不会重复叠加
+        // overlaidRuns 为画在表单中的文本，原运算对象已被遮盖，不能再直接替换
+        QByteArray overlay;
+        QSet<int> overlaidRuns;
+    };
+    struct SaveSnapshot;
+
+    void extractPage(int pageIndex);
+    EditRun& editRun(const EditRunIndex &index) { return m_pages[index.first].runs[index.second]; }
+    // 修改后更新 dirty 并通知视图
+    void markChanged(const EditRunIndex &index);
+    void updateDirty(const EditRunIndex &index);
+    // 在后台线程执行，只访问快照和文档
+    void writeSnapshot(SaveSnapshot &snapshot);
+    void writeTextLayer(SaveSnapshot &snapshot);
+    void onSaveFinished(const std::shared_ptr<SaveSnapshot> &snapshot);
+    // 保存到原文件后，保存的内容成为新的原文本
+    void markSaved(const SaveSnapshot &snapshot);
+    // 完整重写原文件并重新加载后，按新文档的内容流更新运算对象的位置和字体
+    void rebindPage(int pageIndex, const std::vector<UPdfTextState> &states);
+
+    QString m_fileName;
+    // 后台保存时与保存线程共享，切换文档不会释放正在保存的文档
+    std::shared_ptr<PoDoFo::PdfMemDocument> m_document;
+    // 保存线程只在复制页面时持有，期间提取页面文本需要等待
+    QMutex m_documentMutex;
+    // 保存到原文件的增量更新中新对象占用的编号之后的第一个编号，内存中的文档没有这些对象
+    uint32_t m_nextObjectNumber;
+    QVector<Page> m_pages;
+    QSet<EditRunIndex> m_dirtyRuns;
+    QUndoStack *m_undoStack;
+    int m_lastGesture;
+    bool m_saving;
+    std::atomic<bool> m_cancelSave;
+    // 保存时并行压缩内容流；保存线程本身在全局线程池中，不能在全局线程池中等待
+    QThreadPool m_compressPool;
+    int m_compressionLevel;
+    bool m_compactSave;
+    bool m_optimizeSave;
+    bool m_reproducibleSave;
+    bool m_linearizeSave;
+    bool m_downsampleImages;
+    int m_imageTargetDpi;
+    int m_jpegQuality;
+    QMap<QString, qint64> m_savedBytes;
+};
+
+#endif // EDITMODEL_H
@@ -0,0 +1,49 @@
+#ifndef FONTMETRICSCACHE_H
+#define FONTMETRICSCACHE_H
+
+#include <QCache>
+#include <QFont>
+#include <QFontMetrics>
+#include <QFontMetricsF>
+#include <QString>
+
+#include <array>
+
+// 进程内共享的字体度量缓存，以 QFont::key() 为键，最多保留 MAX_ENTRIES 个字体，超出时淘汰最久未用的
+// 注：QFontMetrics 只在 GUI 线程使用，缓存本身不加锁
+class FontMetricsCache
+{
+public:
+    struct Entry {
+        explicit Entry(const QFont& font);
+
+        QFontMetrics metrics;
+        QFontMetricsF metricsF;
+        // Latin-1 码位的字符宽度表（不取整），-1 表示需要交给 Qt 排版计算（控制字符、字体缺字等）
+        std::array<qreal, 256> advances;
+    };
+
+    static FontMetricsCache& instance();
+
+    // 返回的引用在下一次调用 entry() 之前有效，之后可能已被淘汰
+    const Entry& entry(const QFont& font);
+
+    // 拉丁文本直接查表求和，其他文字（CJK、阿拉伯文等）回退到 QFontMetricsF::horizontalAdvance
+    // 小数宽度累加后只在最后取整一次，误差不随文本长度增长
+    int horizontalAdvance(const QFont& font, const QString& text);
+    int height(const QFont& font);
+
+    void clear();
+
+    // 每次缩放都会产生新的字号，缓存的字体数需要有上限
+    static const int MAX_ENTRIES = 64;
+
+private:
+    FontMetricsCache();
+    FontMetricsCache(const FontMetricsCache&) = delete;
+    FontMetricsCache& operator=(const FontMetricsCache&) = delete;
+
+    QCache<QString, Entry> m_entries;
+};
+
+#endif // FONTMETRICSCACHE_H
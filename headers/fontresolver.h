@@ -0,0 +1,35 @@
+#ifndef FONTRESOLVER_H
+#define FONTRESOLVER_H
+
+#include <QFont>
+#include <QHash>
+#include <QString>
+
+#include <podofo/podofo.h>
+
+// 保存时把 QFont 解析为文档中的 PdfFont：同一族、粗细、样式的字体只查找一次
+// 查找到的字体文件路径记录在 QSettings 中，之后的保存（包括重新启动后）直接从文件创建字体，
+// 不需要再通过 fontconfig 查找
+class FontResolver
+{
+public:
+    explicit FontResolver(PoDoFo::PdfDocument &document);
+
+    // 找不到时返回 nullptr
+    PoDoFo::PdfFont* resolve(const QFont &font);
+
+    // 创建字体时使用的选项，如可重现保存时用 DontSubset 嵌入完整的字体，
+    // 子集的前缀和内容与本次保存用到了哪些字形无关
+    void setCreateFlags(PoDoFo::PdfFontCreateFlags flags) { m_createParams.Flags = flags; }
+
+private:
+    static QString cacheKey(const QFont &font);
+    PoDoFo::PdfFont* loadCachedPath(const QString &key);
+    static void storeCachedPath(const QString &key, const PoDoFo::PdfFont &font);
+
+    PoDoFo::PdfDocument &m_document;
+    QHash<QString, PoDoFo::PdfFont*> m_fonts;
+    PoDoFo::PdfFontCreateParams m_createParams;
+};
+
+#endif // FONTRESOLVER_H
@@ -0,0 +1,38 @@
+#ifndef IMAGEDOWNSAMPLER_H
+#define IMAGEDOWNSAMPLER_H
+
+#include <QtGlobal>
+
+#include <podofo/podofo.h>
+
+// 缩小并重新压缩分辨率过高的图片：按图片在页面上绘制的大小计算实际分辨率（DPI），
+// 超过目标分辨率的图片缩小到目标分辨率，以 JPEG 重新编码，结果更小时才替换
+// 一张图片在多处绘制时按绘制得最大的一处计算；只在注释外观等页面内容以外绘制的图片不处理
+// 只处理 8 位灰度和 RGB 图片（未压缩、FlateDecode 或 DCTDecode），
+// 黑白扫描（CCITT、JBIG2）、索引色、CMYK 和带颜色键遮罩的图片保持不变
+class ImageDownsampler
+{
+public:
+    explicit ImageDownsampler(PoDoFo::PdfDocument &document);
+
+    void setTargetDpi(int dpi) { m_targetDpi = dpi; }
+    // JPEG 质量：1 ~ 100
+    void setJpegQuality(int quality) { m_jpegQuality = quality; }
+
+    // 返回重新编码的图片数，解码和编码在线程池中并行进行
+    int run();
+
+    // run() 之后有效
+    qint64 savedBytes() const { return m_savedBytes; }
+
+    static const int DEFAULT_TARGET_DPI = 150;
+    static const int DEFAULT_JPEG_QUALITY = 75;
+
+private:
+    PoDoFo::PdfDocument &m_document;
+    int m_targetDpi;
+    int m_jpegQuality;
+    qint64 m_savedBytes;
+};
+
+#endif // IMAGEDOWNSAMPLER_H
@@ -0,0 +1,66 @@
+#ifndef INCREMENTALWRITER_H
+#define INCREMENTALWRITER_H
+
+#include <QByteArray>
+#include <QMap>
+
+#include <memory>
+
+#include <podofo/podofo.h>
+
+class QIODevice;
+
+// 以增量更新的方式保存：在原文件后面追加修改过的对象、新对象和一节新的交叉引用
+// 另存为时原样复制原文件再追加，保存到原文件时直接追加到原文件末尾
+// 交叉引用的格式与原文件最后一节相同（交叉引用表或交叉引用流），加密的文档用原来的密钥加密写入的对象
+// 只使用传入的对象副本，不访问文档，可以在保存线程中使用
+class IncrementalWriter
+{
+public:
+    // trailer：原文档的文件尾字典；size：原文档中最大的对象编号加 1；encrypt 为空表示不加密
+    IncrementalWriter(const PoDoFo::PdfDictionary &trailer, uint32_t size,
+                      std::shared_ptr<const PoDoFo::PdfEncrypt> encrypt = nullptr);
+
+    // 为新对象分配编号
+    PoDoFo::PdfReference createObject();
+    // 写入不含流的对象，替换同一编号原来的对象
+    void setObject(const PoDoFo::PdfReference &ref, const PoDoFo::PdfObject &value);
+    // 写入流对象，data 已按 dictionary 中的 /Filter 编码，/Length 在写入时设置
+    void setStream(const PoDoFo::PdfReference &ref, const PoDoFo::PdfDictionary &dictionary, const QByteArray &data);
+
+    // 交叉引用流的压缩级别：0 ~ 9，-1 为 zlib 默认级别
+    void setCompressionLevel(int level) { m_compressionLevel = level; }
+
+    // source 为原文件，需要可以随机读取；失败时抛出 PdfError
+    void write(QIODevice &source, PoDoFo::OutputStreamDevice &device);
+    // 直接追加到原文件末尾：file 以读写方式打开，device 写入同一个 file
+    // 失败时抛出 PdfError，已追加的内容由调用者截断
+    void append(QIODevice &file, PoDoFo::OutputStreamDevice &device);
+
+    // 新的文件尾中的 /Size
+    uint32_t size() const { return m_size; }
+    int objectCount() const { return m_objects.size(); }
+
+private:
+    struct Entry {
+        PoDoFo::PdfReference ref;
+        PoDoFo::PdfObject value;    // 流对象为流的字典
+        QByteArray data;
+        bool stream = false;
+    };
+
+    // 原文件中最后一节交叉引用的位置，以及它是否为交叉引用流
+    static quint64 findLastXRef(QIODevice &source, bool &isStream);
+    // 在 device 的当前位置写入对象、交叉引用和文件尾
+    void writeUpdate(PoDoFo::OutputStreamDevice &device, quint64 prevOffset, bool xrefStream);
+    void writeEntry(PoDoFo::OutputStreamDevice &device, const Entry &entry);
+
+    PoDoFo::PdfDictionary m_trailer;
+    uint32_t m_size;
+    std::shared_ptr<const PoDoFo::PdfEncrypt> m_encrypt;
+    int m_compressionLevel;
+    // 以 UPdfReferenceKey 为键，按编号排序
+    QMap<quint64, Entry> m_objects;
+};
+
+#endif // INCREMENTALWRITER_H
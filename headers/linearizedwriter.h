@@ -0,0 +1,29 @@
+#ifndef LINEARIZEDWRITER_H
+#define LINEARIZEDWRITER_H
+
+#include <podofo/podofo.h>
+
+// 以线性化（Fast Web View）格式完整重写文档：第一页需要的对象都在文件开头，
+// 并写入页面偏移和共享对象的提示表，阅读器读到第一页的末尾（/E）就能显示第一页
+// 其余页面按页码顺序排列，每页的私有对象紧跟在页面之后，多页共用的对象放在所有页面之后
+// 对象按在文件中的位置重新编号，不可达的对象不会写入；不支持加密的文档
+class LinearizedWriter
+{
+public:
+    explicit LinearizedWriter(PoDoFo::PdfDocument &document);
+
+    // 没有压缩的流和提示流的压缩级别：0 ~ 9，-1 为 zlib 默认级别
+    void setCompressionLevel(int level) { m_compressionLevel = level; }
+    // 文件标识符（/ID）取对象内容的摘要，相同的内容写出相同的字节
+    void setDeterministicId(bool deterministic) { m_deterministicId = deterministic; }
+
+    // 失败时抛出 PdfError
+    void write(PoDoFo::OutputStreamDevice &device);
+
+private:
+    PoDoFo::PdfDocument &m_document;
+    int m_compressionLevel;
+    bool m_deterministicId;
+};
+
+#endif // LINEARIZEDWRITER_H
@@ -42,6 +42,8 @@
 #include <QUrl>
 #include <QVector>
 
+#include <functional>
+
 Q_DECLARE_LOGGING_CATEGORY(lcExample)
 
 namespace Ui {
@@ -56,6 +58,11 @@ class QPdfView;
 
 class PageSelector;
 class ZoomSelector;
+class PageTileCache;
+class PageImageCache;
+class ThumbnailModel;
+class EditModel;
+class EditJournal;
 
 class MainWindow : public QMainWindow
 {
@@ -73,13 +80,25 @@ private slots:
 
     void PoDoFoDemo(int choice);
 
-    void setEditablePageSize(double width, double height);
     void loadEditablePDF();
+    void scrollToEditablePage(int pageIndex);
 
     // File Menu
     void on_actionOpen_triggered();
     void on_actionQuit_triggered();
+    void on_actionSave_triggered();
     void on_actionSave_As_triggered();
+    void on_actionExport_Text_triggered();
+    void on_actionCompression_Level_triggered();
+    void on_actionCompact_Save_triggered(bool checked);
+    void on_actionOptimize_on_Save_triggered(bool checked);
+    void on_actionReproducible_Save_triggered(bool checked);
+    void on_actionFast_Web_View_triggered(bool checked);
+    void on_actionDownsample_Images_triggered(bool checked);
+    void on_actionImage_Resolution_triggered();
+    // Edit Menu
+    void on_actionUndo_triggered();
+    void on_actionRedo_triggered();
     // Help Menu
     void on_actionAbout_triggered();
     void on_actionAbout_Qt_triggered();
@@ -89,6 +108,7 @@ private slots:
     void on_actionPrevious_Page_triggered();
     void on_actionNext_Page_triggered();
     void on_actionContinuous_triggered();
+    void on_actionPage_Cache_triggered();
     // Demo Menu
     void on_actionPoDoFo_Helloworld_triggered();
     void on_actionPoDoFo_Base14Fonts_triggered();
@@ -96,16 +116,23 @@ private slots:
     void on_tabWidgetTools_currentChanged(int index);
 
 private:
+    // start 开始后台保存，这里显示进度并等待完成，返回是否成功
+    bool saveEditablePDF(const QString &fileName, const std::function<bool()> &start);
+
     Ui::MainWindow *ui;
     ZoomSelector *m_zoomSelector;
     PageSelector *m_pageSelector;
 
     QPdfDocument *m_document;
     QUrl m_docLocation;
-
-    QVector<QTextEdit *> m_textEdits;
-    // pt=>px 的转换不够精确，需记录原始坐标
-    QVector<QPointF> m_textPositions;
+    PageTileCache *m_tileCache;
+    // 阅读模式已渲染的页面
+    PageImageCache *m_pageCache;
+    // Pages 标签页的缩略图
+    ThumbnailModel *m_thumbnailModel;
+    EditModel *m_editModel;
+    // 编辑日志，异常退出后用于恢复未保存的修改
+    EditJournal *m_editJournal;
 
     static const int DEMO_HELLOWORLD = 0;
     static const int DEMO_BASE14FONTS = 1;
@@ -0,0 +1,108 @@
+#ifndef PAGEIMAGECACHE_H
+#define PAGEIMAGECACHE_H
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QPdfDocumentRenderOptions>
+#include <QSet>
+#include <QSize>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+
+class QPdfDocument;
+
+struct PageImageKey {
+    int page;
+    int zoom;       // 每点的逻辑像素数（千分比）
+    int dpr;        // devicePixelRatio（千分比）
+    int rotation;   // QPdfDocumentRenderOptions::Rotation
+};
+
+bool operator==(const PageImageKey& lhs, const PageImageKey& rhs);
+uint qHash(const PageImageKey& key, uint seed = 0);
+
+// 阅读模式的整页图片：渲染结果存入 LRU 缓存，来回滚动时不需要重新渲染
+// 缺失的页面在工作线程中渲染，完成后发出 pageReady 信号
+// 预渲染的页面优先级较低，排在可见页面之后，可以整批作废
+// 缩放后新的渲染完成前，视图可以先用其他缩放下的图片缩放绘制
+class PageImageCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int DEFAULT_BUDGET = 128;  // 单位：MB
+
+    explicit PageImageCache(QObject *parent = nullptr);
+    ~PageImageCache();
+
+    void setDocument(QPdfDocument *document);
+
+    // 缓存上限（单位：MB）
+    void setBudget(int megabytes);
+    int budget() const { return m_images.maxCost() / 1024; }
+    qint64 cachedBytes() const { return qint64(m_images.totalCost()) * 1024; }
+
+    // 返回缓存中的页面，未命中则返回空图并在后台渲染
+    // size 是渲染后的设备像素尺寸
+    QImage image(int page, qreal zoom, qreal dpr, QPdfDocumentRenderOptions::Rotation rotation, const QSize &size);
+
+    // 同一页面在其他缩放下缓存的图片中，分辨率与请求最接近的一张；没有时返回空图
+    // 不计入命中统计，也不发起渲染
+    QImage closestImage(int page, qreal zoom, qreal dpr, QPdfDocumentRenderOptions::Rotation rotation);
+
+    // 尚未开始的渲染全部作废，如缩放再次改变时；已完成的结果仍然缓存
+    void cancelPending();
+
+    // 预先渲染不在缓存中的页面，不影响 LRU 顺序和命中统计
+    void prefetch(int page, qreal zoom, qreal dpr, QPdfDocumentRenderOptions::Rotation rotation, const QSize &size);
+    // 尚未开始的预渲染作废，如移动方向改变时
+    void cancelPrefetch();
+
+    // image() 的命中和未命中次数，都按每次调用计入，等待渲染期间的重绘也算未命中
+    int hitCount() const { return m_hits; }
+    int missCount() const { return m_misses; }
+    void resetStatistics();
+
+public slots:
+    // 文档重新加载前调用，丢弃缓存和尚未完成的渲染结果，返回时不再有渲染在进行
+    void clear();
+
+signals:
+    void pageReady(int page);
+
+private:
+    void requestImage(const PageImageKey &key, const QSize &size, bool prefetch = false);
+
+    // QCache::object() 会把图片移到 LRU 的最前面，closestImage() 改为在 m_index 中查找，不影响淘汰顺序
+    // 缓存中的对象删除（包括被淘汰）时从 m_index 中移除；QImage 隐式共享，不占用额外的内存
+    struct CachedImage {
+        CachedImage(QHash<PageImageKey, QImage> &index, const PageImageKey &key, const QImage &image)
+            : index(index), key(key), image(image) {}
+        ~CachedImage() { index.remove(key); }
+        QHash<PageImageKey, QImage> &index;
+        PageImageKey key;
+        QImage image;
+    };
+
+    QPdfDocument *m_document;
+    // 在 m_images 之后析构
+    QHash<PageImageKey, QImage> m_index;
+    QCache<PageImageKey, CachedImage> m_images;
+    QSet<PageImageKey> m_pending;
+    // 排队中的预渲染的状态（PrefetchState），可见页面请求同一张图片时抢占，按可见页面的优先级重新排队
+    QHash<PageImageKey, std::shared_ptr<std::atomic<int>>> m_prefetching;
+    QThreadPool m_pool;
+    // 每次 clear() 递增，过期的渲染结果直接丢弃
+    int m_generation;
+    // 每次 cancelPending()、cancelPrefetch() 递增，工作线程开始渲染前检查
+    std::atomic<int> m_renderGeneration;
+    std::atomic<int> m_prefetchGeneration;
+    int m_hits;
+    int m_misses;
+};
+
+#endif // PAGEIMAGECACHE_H
@@ -0,0 +1,68 @@
+#ifndef PAGETILECACHE_H
+#define PAGETILECACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QObject>
+#include <QSet>
+#include <QSize>
+#include <QThreadPool>
+
+#include <atomic>
+
+class QPdfDocument;
+
+struct PageTileKey {
+    int page;
+    int zoom;   // 缩放比例（千分比）
+    int dpr;    // devicePixelRatio（千分比）
+    int column;
+    int row;
+};
+
+bool operator==(const PageTileKey& lhs, const PageTileKey& rhs);
+uint qHash(const PageTileKey& key, uint seed = 0);
+
+// 编辑模式的页面背景：按块渲染页面，渲染结果存入 LRU 缓存
+// 缺失的块在工作线程中渲染，完成后发出 tileReady 信号
+// 请求了新的缩放后，其他缩放下尚未开始的块不再渲染
+class PageTileCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int TILE_SIZE = 256;   // 单位：设备像素
+
+    explicit PageTileCache(QObject *parent = nullptr);
+    ~PageTileCache();
+
+    void setDocument(QPdfDocument *document);
+
+    // 缓存上限（单位：MB）
+    void setBudget(int megabytes);
+
+    // 返回缓存中的块，未命中则返回空图并在后台渲染
+    // pageSize 是整页渲染后的设备像素尺寸
+    QImage tile(int page, qreal zoom, qreal dpr, int column, int row, const QSize &pageSize);
+
+public slots:
+    // 文档重新加载前调用，丢弃缓存和尚未开始的渲染，并等待正在进行的渲染结束
+    void clear();
+
+signals:
+    void tileReady(int page);
+
+private:
+    void requestTile(const PageTileKey &key, const QSize &pageSize);
+
+    QPdfDocument *m_document;
+    QCache<PageTileKey, QImage> m_tiles;
+    QSet<PageTileKey> m_pending;
+    QThreadPool m_pool;
+    // 每次 clear() 递增，过期的渲染直接跳过，结果直接丢弃
+    std::atomic<int> m_generation;
+    // 最近一次请求的缩放（千分比），工作线程开始渲染前检查
+    std::atomic<int> m_zoom;
+};
+
+#endif // PAGETILECACHE_H
@@ -0,0 +1,105 @@
+#ifndef PDFEDITVIEW_H
+#define PDFEDITVIEW_H
+
+#include <QFont>
+#include <QPdfView>
+#include <QPoint>
+#include <QRectF>
+#include <QTransform>
+#include <QVector>
+#include <QWidget>
+
+class QMouseEvent;
+class QTextEdit;
+
+class EditModel;
+class PageTileCache;
+class PdfPageWidget;
+
+// 编辑模式的连续多页视图，放在 ui->pdfEditor 中滚动
+// 只有靠近可视区域的页面才会提取文本并生成文本框，远离的页面会被释放
+// 缩放通过页面变换实现，已生成的文本框只调整位置和字号
+class PdfEditView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PdfEditView(QWidget *parent = nullptr);
+    ~PdfEditView();
+
+    // 视图不持有文本，只根据模型生成和释放文本框
+    void setModel(EditModel *model);
+    void setTileCache(PageTileCache *tileCache);
+
+    int currentPage() const { return m_currentPage; }
+    QRect pageRect(int pageIndex) const;
+
+    // 同时驻留的页面数上限
+    static const int MAX_RESIDENT_PAGES = 8;
+
+public slots:
+    void setZoomMode(QPdfView::ZoomMode mode);
+    void setZoomFactor(qreal factor);
+
+signals:
+    void currentPageChanged(int pageIndex);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+    void moveEvent(QMoveEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+
+private slots:
+    void updateResidentPages();
+    void onModelReset();
+    void onRunChanged(int pageIndex, int runIndex);
+
+private:
+    struct PageSlot {
+        QRectF trimBox;     // 单位：pt
+        QRect rect;         // 在视图中的位置（单位：px）
+        QTransform transform;   // PDF 坐标 => 设备像素，包含 TrimBox 偏移、缩放和 devicePixelRatio
+        PdfPageWidget *widget = nullptr;
+        QVector<QTextEdit *> textEdits;     // 与模型中的文本一一对应，页面驻留时有效
+    };
+
+    // 按住 Alt 拖动文本框时的状态，textEdit 为空表示没有拖动
+    struct DragState {
+        QTextEdit *textEdit = nullptr;
+        int pageIndex = -1;
+        int runIndex = -1;
+        int gesture = 0;
+        QPoint start;       // 按下时鼠标的全局位置（单位：px）
+        QPointF origin;     // 按下时文本的位置（单位：pt）
+    };
+
+    void scheduleUpdate();
+    void updateZoom();
+    void layoutPages();
+    void materializePage(int pageIndex);
+    void releasePage(int pageIndex);
+    QFont displayFont(const QFont& font) const;
+    QTextEdit* createTextEdit(PdfPageWidget *pageWidget, int pageIndex, int runIndex);
+    // 按页面变换批量更新文本框的位置、字号和大小
+    void layoutTextEdits(int pageIndex);
+    // baseline: 文本左下角在页面中的位置（单位：px）
+    void layoutTextEdit(int pageIndex, int runIndex, const QPointF &baseline);
+    // 处理文本框的鼠标事件，返回 true 表示事件已用于拖动
+    bool dragTextEdit(QTextEdit *textEdit, QMouseEvent *event);
+
+    EditModel *m_model;
+    PageTileCache *m_tileCache;
+
+    QPdfView::ZoomMode m_zoomMode;
+    qreal m_zoomFactor;
+    qreal m_zoom;       // 实际使用的缩放比例
+
+    QVector<PageSlot> m_pages;
+    QVector<int> m_residentPages;
+    int m_currentPage;
+    bool m_updatePending;
+    DragState m_drag;
+};
+
+#endif // PDFEDITVIEW_H
@@ -0,0 +1,35 @@
+#ifndef PDFPAGEWIDGET_H
+#define PDFPAGEWIDGET_H
+
+#include <QWidget>
+
+class PageTileCache;
+
+// 编辑模式下的页面：先绘制渲染好的页面背景（图片、矢量图形等），文本框作为子控件叠加在上面
+class PdfPageWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PdfPageWidget(QWidget *parent = nullptr);
+
+    void setTileCache(PageTileCache *tileCache);
+    // pageIndex = pageNumber - 1，-1 表示不绘制背景
+    void setPageIndex(int pageIndex);
+    int pageIndex() const { return m_pageIndex; }
+    // 缩放比例，用于区分不同缩放下渲染的页面背景
+    void setZoom(qreal zoom);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private slots:
+    void onTileReady(int page);
+
+private:
+    PageTileCache *m_tileCache;
+    int m_pageIndex;
+    qreal m_zoom;
+};
+
+#endif // PDFPAGEWIDGET_H
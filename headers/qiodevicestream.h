@@ -0,0 +1,43 @@
+#ifndef QIODEVICESTREAM_H
+#define QIODEVICESTREAM_H
+
+#include <QIODevice>
+
+#include <functional>
+
+#include <podofo/podofo.h>
+
+// 把 PoDoFo 的输出写入 QIODevice（如 QSaveFile），便于使用临时文件和原子替换
+// 每次写入后调用 progress(已写入的字节数)，可在回调中抛出异常中断保存
+class QIODeviceOutputStream : public PoDoFo::OutputStreamDevice
+{
+public:
+    explicit QIODeviceOutputStream(QIODevice &device, std::function<void(qint64)> progress = nullptr);
+
+    bool Eof() const override { return false; }
+    size_t GetLength() const override;
+    size_t GetPosition() const override;
+    bool CanSeek() const override { return !m_device.isSequential(); }
+
+    // 之后写入失败时不抛出异常，只记录错误并丢弃剩余的数据，用 errorString() 检查
+    // 用于在析构函数中写入的 PdfStreamedDocument
+    void deferErrors() { m_deferErrors = true; }
+    // 丢弃之后的所有写入，用于取消或出错后析构 PdfStreamedDocument
+    void discard() { m_discard = true; }
+    const QString& errorString() const { return m_error; }
+
+protected:
+    void writeBuffer(const char* buffer, size_t size) override;
+    void flush() override;
+    void seek(ssize_t offset, PoDoFo::SeekDirection direction) override;
+
+private:
+    QIODevice &m_device;
+    std::function<void(qint64)> m_progress;
+    qint64 m_written;
+    bool m_deferErrors;
+    bool m_discard;
+    QString m_error;
+};
+
+#endif // QIODEVICESTREAM_H
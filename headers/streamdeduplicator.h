@@ -0,0 +1,42 @@
+#ifndef STREAMDEDUPLICATOR_H
+#define STREAMDEDUPLICATOR_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+#include <QString>
+
+#include <podofo/podofo.h>
+
+// 合并文档中内容相同的对象：先合并数据和字典都相同的流（字体文件、图片等），
+// 再合并因此变得相同的字体、字体描述和字体的宽度数组，重复直到没有可合并的对象
+// 合并后改写所有引用，并删除不可达的对象
+// 页面的内容流不参与合并，否则修改一页会影响另一页
+class StreamDeduplicator
+{
+public:
+    explicit StreamDeduplicator(PoDoFo::PdfDocument &document);
+
+    // 返回合并和删除的对象数
+    int run();
+
+    // 各类对象（Image、FontFile、Font 等）节省的字节数，run() 之后有效
+    const QMap<QString, qint64>& savedBytes() const { return m_savedBytes; }
+    qint64 totalSavedBytes() const;
+
+private:
+    // 返回本轮合并的对象数
+    int mergePass();
+    void removeUnreachable();
+    void countRemoved(const PoDoFo::PdfObject &object);
+    // 对象用于比较的内容，缓存到对象被改写或删除
+    QByteArray objectContent(const PoDoFo::PdfObject &object);
+
+    PoDoFo::PdfDocument &m_document;
+    // 以 UPdfReferenceKey 为键，各轮之间只重新序列化引用被替换的对象
+    QHash<quint64, QByteArray> m_contents;
+    QMap<QString, qint64> m_savedBytes;
+    int m_removedCount;
+};
+
+#endif // STREAMDEDUPLICATOR_H
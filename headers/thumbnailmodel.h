@@ -0,0 +1,74 @@
+#ifndef THUMBNAILMODEL_H
+#define THUMBNAILMODEL_H
+
+#include <QAbstractListModel>
+#include <QCache>
+#include <QImage>
+#include <QSet>
+#include <QSizeF>
+#include <QThreadPool>
+#include <QVector>
+
+class QPdfDocument;
+
+// 页面缩略图：每页一行，视图只对可见的行取数据，缩略图在此时才在线程池中渲染
+// 渲染结果写入磁盘缓存，目录按文件指纹区分，重新打开同一文件时直接读取，不需要再渲染
+// 磁盘缓存按最近打开的时间淘汰：超过期限或总大小超过上限时，先删除最久未打开的文件的目录
+// 快速滚动时最后请求的页面先处理，滚过的页面稍后补齐
+// 计算指纹和清理磁盘缓存在工作线程中进行，完成前缩略图的请求只排队
+class ThumbnailModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    static const int THUMBNAIL_WIDTH = 120;     // 单位：逻辑像素
+    static const int MEMORY_BUDGET = 32;        // 单位：MB
+    static const int DISK_BUDGET = 256;         // 单位：MB
+    static const int DISK_MAX_AGE = 30;         // 单位：天
+
+    explicit ThumbnailModel(QObject *parent = nullptr);
+    ~ThumbnailModel();
+
+    // fileName 用于计算文件指纹，在文档加载前设置，文档 Ready 后重置模型
+    void setDocument(QPdfDocument *document);
+    void setFileName(const QString &fileName);
+
+    // 文件的大小、修改时间和首尾各 64 KB 内容的摘要，文件被修改后指纹随之改变
+    static QString fingerprint(const QString &fileName);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private slots:
+    void onDocumentStatusChanged();
+
+private:
+    void requestThumbnail(int page) const;
+    void startJobs() const;
+    void onThumbnailReady(int generation, int page, const QImage &image);
+    void onDiskCacheReady(int generation, const QString &cacheDir);
+    QString cacheFileName(int page) const;
+    // 在工作线程中调用：计算指纹，创建并标记缓存目录，清理其他目录；失败时返回空字符串
+    static QString prepareDiskCache(const QString &fileName);
+    // 删除 root 下过期和超出上限的目录，不删除正在使用的 current
+    static void pruneDiskCache(const QString &root, const QString &current);
+
+    QPdfDocument *m_document;
+    QString m_fileName;
+    QString m_cacheDir;     // 为空时不使用磁盘缓存
+    bool m_cacheReady;      // 磁盘缓存目录已确定，可以开始渲染
+    QVector<QSizeF> m_pageSizes;    // 文档加载后读取一次（单位：pt）
+    qreal m_dpr;
+    QImage m_placeholder;
+
+    // data() 是 const 的，按需渲染需要修改以下状态
+    mutable QCache<int, QImage> m_thumbnails;
+    mutable QSet<int> m_pending;
+    mutable QVector<int> m_queue;    // 等待渲染的页面，后进先出
+    mutable int m_running;
+    mutable QThreadPool m_pool;
+    // 每次重置递增，过期的渲染结果直接丢弃
+    int m_generation;
+};
+
+#endif // THUMBNAILMODEL_H
@@ -2,7 +2,12 @@
 #define TOOLS_H
 
 #include <QString>
+#include <QByteArray>
 #include <QFont>
+#include <QHash>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
 
 #include <vector>
 #include <string>
@@ -14,6 +19,22 @@ struct UPdfTextState {
     double fontScale = 1;
     double charSpacing = 0;
     double wordSpacing = 0;
+    // Tj/TJ 的运算对象在解码后内容流中的位置，operandLength 为 0 表示无法解码
+    size_t operandOffset = 0;
+    size_t operandLength = 0;
+    std::string operandText;    // 运算对象解码后的文本（UTF-8）
+};
+
+// 页面中的一段文本，坐标为 PDF 坐标（单位：pt）
+struct UPdfTextRun {
+    QString text;
+    QPointF pos;        // 文本左下角（基线起点）
+    QFont font;
+    QRectF bounds;      // 原文本占据的区域，保存时用于遮盖原文本
+    // 原文本的 Tj/TJ 运算对象在解码后内容流中的位置，-1 表示无法直接替换
+    const PoDoFo::PdfFont* pdfFont = nullptr;
+    qint64 operandOffset = -1;
+    qint64 operandLength = 0;
 };
 
 void PdfFont2QFont(const QString& baseFontName, QString& to_fontName, QFont::StyleHint& to_hint,
@@ -24,5 +45,22 @@ void PoDoFoHelloworld(std::string outputfile);
 void PoDoFoBase14Fonts(std::string outputfile);
 
 void UPdfExtractTextStates(PoDoFo::PdfPage& page, std::vector<UPdfTextState>& textStates);
+void UPdfExtractTextRuns(PoDoFo::PdfPage& page, QVector<UPdfTextRun>& runs);
+
+// 引用作为 QHash/QSet 的键
+quint64 UPdfReferenceKey(const PoDoFo::PdfReference& ref);
+// 按出现顺序收集对象（包括嵌套的字典和数组）中的引用
+void UPdfCollectReferences(const PoDoFo::PdfObject& object, QVector<PoDoFo::PdfReference>& references);
+// 把对象中的引用按 replaced 替换，键为 UPdfReferenceKey；返回是否替换了引用
+bool UPdfRewriteReferences(PoDoFo::PdfObject& object, const QHash<quint64, PoDoFo::PdfReference>& replaced);
+
+// 用 FlateDecode 压缩，level 为 zlib 压缩级别（-1 ~ 9）
+QByteArray UPdfDeflate(const QByteArray& data, int level);
+// 序列化为 "n 0 obj ... stream ... endstream endobj"，/Length 按 data 设置
+QByteArray UPdfSerializeStream(uint32_t number, PoDoFo::PdfDictionary& dictionary, const QByteArray& data);
+// 把间接对象序列化为编号为 number 的对象，其中的引用按 numbers 重新编号
+// 流的数据保持原样，没有压缩的用 FlateDecode 压缩
+QByteArray UPdfSerializeObject(const PoDoFo::PdfObject& object, uint32_t number,
+                               const QHash<quint64, PoDoFo::PdfReference>& numbers, int level);
 
 #endif // TOOLS_H
@@ -0,0 +1,264 @@
+#include "cachedpdfview.h"
+#include "pageimagecache.h"
+
+#include <QGuiApplication>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QPdfDocument>
+#include <QPdfPageNavigation>
+#include <QScreen>
+#include <QScrollBar>
+#include <QVector>
+#include <QWheelEvent>
+#include <QtMath>
+
+// 缩放的范围，滚轮连续滚动时避免渲染过大的图片
+static const qreal MinZoomFactor = 0.1;
+static const qreal MaxZoomFactor = 10.0;
+
+CachedPdfView::CachedPdfView(QWidget *parent)
+    : QPdfView(parent)
+    , m_pageCache(nullptr)
+    , m_lastAnchor(0)
+    , m_direction(1)
+    , m_pendingZoomFactor(1.0)
+    , m_layoutValid(false)
+{
+    connect(this, &QPdfView::zoomFactorChanged, this, &CachedPdfView::onZoomChanged);
+    connect(this, &QPdfView::zoomModeChanged, this, &CachedPdfView::onZoomChanged);
+    connect(this, &QPdfView::documentChanged, this, &CachedPdfView::onDocumentChanged);
+    // 影响布局的属性改变后重新计算
+    connect(this, &QPdfView::zoomFactorChanged, this, &CachedPdfView::invalidateLayout);
+    connect(this, &QPdfView::zoomModeChanged, this, &CachedPdfView::invalidateLayout);
+    connect(this, &QPdfView::pageModeChanged, this, &CachedPdfView::invalidateLayout);
+    connect(this, &QPdfView::pageSpacingChanged, this, &CachedPdfView::invalidateLayout);
+    connect(this, &QPdfView::documentMarginsChanged, this, &CachedPdfView::invalidateLayout);
+    // 单页模式只布局当前页
+    connect(pageNavigation(), &QPdfPageNavigation::currentPageChanged, this, [this]() {
+        if (pageMode() == SinglePage)
+            invalidateLayout();
+    });
+
+    m_zoomTimer.setSingleShot(true);
+    m_zoomTimer.setInterval(ZOOM_COALESCE_MS);
+    connect(&m_zoomTimer, &QTimer::timeout, this, [this]() {
+        setZoomFactor(m_pendingZoomFactor);
+    });
+}
+
+void CachedPdfView::setPageCache(PageImageCache *pageCache)
+{
+    if (m_pageCache)
+        disconnect(m_pageCache, nullptr, this, nullptr);
+    m_pageCache = pageCache;
+    if (m_pageCache)
+        connect(m_pageCache, &PageImageCache::pageReady, this, &CachedPdfView::onPageReady);
+    viewport()->update();
+}
+
+void CachedPdfView::requestZoomFactor(qreal factor)
+{
+    m_pendingZoomFactor = qBound(MinZoomFactor, factor, MaxZoomFactor);
+    if (!m_zoomTimer.isActive())
+        m_zoomTimer.start();
+}
+
+qreal CachedPdfView::pendingZoomFactor() const
+{
+    return m_zoomTimer.isActive() ? m_pendingZoomFactor : zoomFactor();
+}
+
+void CachedPdfView::onDocumentChanged(QPdfDocument *document)
+{
+    if (document)
+        connect(document, &QPdfDocument::statusChanged, this, &CachedPdfView::onDocumentStatusChanged,
+                Qt::UniqueConnection);
+    onDocumentStatusChanged();
+}
+
+void CachedPdfView::onDocumentStatusChanged()
+{
+    // 文档加载完成后一次读取全部页面的尺寸，卸载时清空
+    m_pointSizes.clear();
+    QPdfDocument *doc = document();
+    if (doc && doc->status() == QPdfDocument::Ready) {
+        m_pointSizes.reserve(doc->pageCount());
+        for (int page = 0; page < doc->pageCount(); page++)
+            m_pointSizes.append(doc->pageSize(page));
+    }
+    invalidateLayout();
+}
+
+void CachedPdfView::invalidateLayout()
+{
+    m_layoutValid = false;
+}
+
+const QHash<int, QRect>& CachedPdfView::pageGeometries() const
+{
+    if (m_layoutValid)
+        return m_geometries;
+    m_layoutValid = true;
+
+    // 与 QPdfViewPrivate::calculateDocumentLayout() 一致，否则与滚动条的范围对不上
+    QHash<int, QRect>& geometries = m_geometries;
+    geometries.clear();
+    if (m_pointSizes.isEmpty())
+        return geometries;
+
+    const QMargins margins = documentMargins();
+    const int viewportWidth = viewport()->width();
+    const int startPage = pageMode() == SinglePage ? pageNavigation()->currentPage() : 0;
+    const int endPage = pageMode() == SinglePage ? startPage + 1 : m_pointSizes.size();
+
+    int totalWidth = 0;
+    for (int page = startPage; page < endPage; page++) {
+        const QSize pageSize = scaledPageSize(page);
+        totalWidth = qMax(totalWidth, pageSize.width());
+        geometries.insert(page, QRect(QPoint(0, 0), pageSize));
+    }
+    totalWidth += margins.left() + margins.right();
+
+    // 水平居中，垂直依次排列
+    int pageY = margins.top();
+    for (int page = startPage; page < endPage; page++) {
+        QRect& geometry = geometries[page];
+        geometry.moveTopLeft(QPoint((qMax(totalWidth, viewportWidth) - geometry.width()) / 2, pageY));
+        pageY += geometry.height() + pageSpacing();
+    }
+    return geometries;
+}
+
+QSize CachedPdfView::scaledPageSize(int page) const
+{
+    const qreal screenResolution = QGuiApplication::primaryScreen()->logicalDotsPerInch() / 72.0;
+    const QSizeF pointSize = this->pointSize(page);
+    const QMargins margins = documentMargins();
+    QSize pageSize = QSizeF(pointSize * screenResolution).toSize();
+    if (zoomMode() == CustomZoom) {
+        pageSize = QSizeF(pointSize * screenResolution * zoomFactor()).toSize();
+    }
+    else if (zoomMode() == FitToWidth && pageSize.width() > 0) {
+        pageSize *= qreal(viewport()->width() - margins.left() - margins.right()) / qreal(pageSize.width());
+    }
+    else if (zoomMode() == FitInView) {
+        const QSize available(viewport()->size() + QSize(-margins.left() - margins.right(), -pageSpacing()));
+        pageSize = pageSize.scaled(available, Qt::KeepAspectRatio);
+    }
+    return pageSize;
+}
+
+void CachedPdfView::paintEvent(QPaintEvent *event)
+{
+    if (!m_pageCache) {
+        QPdfView::paintEvent(event);
+        return;
+    }
+
+    QPainter painter(viewport());
+    painter.fillRect(event->rect(), palette().brush(QPalette::Dark));
+
+    const QRect visible(QPoint(horizontalScrollBar()->value(), verticalScrollBar()->value()), viewport()->size());
+    painter.translate(-visible.topLeft());
+
+    // 页面图片按设备像素渲染，绘制时缩放回逻辑坐标；尚未渲染完成的页面先显示白色
+    const qreal dpr = devicePixelRatioF();
+    const QHash<int, QRect>& geometries = pageGeometries();
+    int firstPage = -1, lastPage = -1;
+    for (auto it = geometries.cbegin(); it != geometries.cend(); ++it) {
+        const QRect& geometry = it.value();
+        if (!geometry.intersects(visible))
+            continue;
+        firstPage = firstPage < 0 ? it.key() : qMin(firstPage, it.key());
+        lastPage = qMax(lastPage, it.key());
+        painter.fillRect(geometry, Qt::white);
+        const qreal zoom = geometry.width() / pointSize(it.key()).width();
+        const QImage image = m_pageCache->image(it.key(), zoom, dpr, QPdfDocumentRenderOptions::Rotation::None,
+                                                geometry.size() * dpr);
+        if (!image.isNull()) {
+            painter.drawImage(geometry, image);
+            continue;
+        }
+        // 渲染完成前先缩放其他缩放下的图片，模糊但位置和内容正确
+        const QImage closest = m_pageCache->closestImage(it.key(), zoom, dpr, QPdfDocumentRenderOptions::Rotation::None);
+        if (!closest.isNull())
+            painter.drawImage(geometry, closest);
+    }
+    if (firstPage >= 0)
+        prefetch(firstPage, lastPage);
+}
+
+bool CachedPdfView::viewportEvent(QEvent *event)
+{
+    // 视口大小随窗口和滚动条的显示而变化，居中和适应宽度/窗口的缩放都依赖它
+    if (event->type() == QEvent::Resize)
+        invalidateLayout();
+    return QPdfView::viewportEvent(event);
+}
+
+void CachedPdfView::wheelEvent(QWheelEvent *event)
+{
+    if (!(event->modifiers() & Qt::ControlModifier)) {
+        QPdfView::wheelEvent(event);
+        return;
+    }
+    // Ctrl+滚轮缩放：每格与放大、缩小一次相同
+    qreal factor = pendingZoomFactor();
+    if (zoomMode() != CustomZoom) {
+        // 适应宽度、适应窗口时以当前页实际的缩放为起点
+        const int page = pageNavigation()->currentPage();
+        const qreal width = pointSize(page).width() * QGuiApplication::primaryScreen()->logicalDotsPerInch() / 72.0;
+        if (width > 0)
+            factor = scaledPageSize(page).width() / width;
+        setZoomMode(CustomZoom);
+    }
+    requestZoomFactor(factor * qPow(qSqrt(2.0), event->angleDelta().y() / 120.0));
+    event->accept();
+}
+
+void CachedPdfView::onZoomChanged()
+{
+    // 旧缩放下尚未开始的渲染已经没有用处，重绘时按新的缩放重新请求
+    // 已经开始的渲染无法中断，结果仍然缓存，可以作为缩放绘制的来源
+    if (m_pageCache)
+        m_pageCache->cancelPending();
+}
+
+void CachedPdfView::prefetch(int firstPage, int lastPage)
+{
+    // 方向改变后，原方向上尚未开始的预渲染作废
+    const int anchor = pageMode() == SinglePage ? pageNavigation()->currentPage() : verticalScrollBar()->value();
+    const int direction = anchor > m_lastAnchor ? 1 : anchor < m_lastAnchor ? -1 : m_direction;
+    m_lastAnchor = anchor;
+    if (direction != m_direction) {
+        m_direction = direction;
+        m_pageCache->cancelPrefetch();
+    }
+
+    // 可见页面已经按需请求过，这里只补充前后的页面，先请求移动方向上的
+    const qreal dpr = devicePixelRatioF();
+    const int pageCount = m_pointSizes.size();
+    const int ahead = m_direction > 0 ? lastPage : firstPage;
+    const int behind = m_direction > 0 ? firstPage : lastPage;
+    QVector<int> pages;
+    for (int i=1; i<=PREFETCH_AHEAD; i++)
+        pages.append(ahead + i * m_direction);
+    for (int i=1; i<=PREFETCH_BEHIND; i++)
+        pages.append(behind - i * m_direction);
+    for (int page : pages) {
+        if (page < 0 || page >= pageCount)
+            continue;
+        const QSize pageSize = scaledPageSize(page);
+        if (pageSize.isEmpty())
+            continue;
+        const qreal zoom = pageSize.width() / pointSize(page).width();
+        m_pageCache->prefetch(page, zoom, dpr, QPdfDocumentRenderOptions::Rotation::None, pageSize * dpr);
+    }
+}
+
+void CachedPdfView::onPageReady(int page)
+{
+    Q_UNUSED(page)
+    // 多个页面相继完成时只重绘一次
+    viewport()->update();
+}
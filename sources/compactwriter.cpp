@@ -0,0 +1,195 @@
+#include "compactwriter.h"
+#include "tools.h"
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QHash>
+#include <QVector>
+
+#include <algorithm>
+#include <string>
+
+using namespace PoDoFo;
+
+// 交叉引用流中的一项
+struct XRefEntry {
+    quint8 type = 0;        // 0：空闲；1：普通对象；2：对象流中的对象
+    quint64 field2 = 0;     // 类型 1 为偏移量，类型 2 为所在对象流的编号
+    quint16 field3 = 0;     // 类型 1 为代号，类型 2 为在对象流中的序号
+};
+
+// 写入输出设备，需要时同时计算已写入内容的摘要，用于生成确定的文件标识符
+class DigestWriter
+{
+public:
+    DigestWriter(OutputStreamDevice &device, bool digest)
+        : m_device(device), m_digest(QCryptographicHash::Md5), m_enabled(digest) {}
+
+    void write(const char *data, size_t size)
+    {
+        m_device.Write(data, size);
+        if (m_enabled)
+            m_digest.addData(data, int(size));
+    }
+    void write(const std::string &data) { write(data.data(), data.size()); }
+    void write(const QByteArray &data) { write(data.constData(), size_t(data.size())); }
+
+    quint64 position() const { return m_device.GetPosition(); }
+    QByteArray digest() const { return m_digest.result(); }
+
+private:
+    OutputStreamDevice &m_device;
+    QCryptographicHash m_digest;
+    bool m_enabled;
+};
+
+CompactWriter::CompactWriter(PdfDocument &document)
+    : m_document(document), m_compressionLevel(-1), m_deterministicId(false),
+      m_packedObjectCount(0), m_objectStreamCount(0)
+{
+
+}
+
+void CompactWriter::write(OutputStreamDevice &device)
+{
+    // 对象流中的字符串不能单独加密
+    if (m_document.IsEncrypted())
+        throw PdfError(PdfErrorCode::NotImplemented, __FILE__, __LINE__,
+                       "Compact save does not support encrypted documents");
+
+    // 1. 从文件尾的字典开始按广度优先的顺序重新编号，编号只取决于对象之间的引用关系
+    //    不可达的对象不会写入
+    PdfIndirectObjectList& objects = m_document.GetObjects();
+    const PdfObject& trailer = m_document.GetTrailer().GetObject();
+    QVector<PdfObject*> order;
+    QHash<quint64, PdfReference> numbers;
+    QVector<PdfReference> pending;
+    UPdfCollectReferences(trailer, pending);
+    for (int i=0; i<pending.size(); i++) {
+        const quint64 key = UPdfReferenceKey(pending[i]);
+        if (numbers.contains(key))
+            continue;
+        PdfObject* object = objects.GetObject(pending[i]);
+        if (object == nullptr)
+            continue;
+        order.append(object);
+        numbers.insert(key, PdfReference(uint32_t(order.size()), 0));
+        UPdfCollectReferences(*object, pending);
+    }
+
+    // 不含流的对象放进对象流，其余的照常写入
+    QVector<PdfObject*> packed, direct;
+    for (PdfObject* object : order) {
+        if (object->HasStream())
+            direct.append(object);
+        else
+            packed.append(object);
+    }
+
+    // 对象流和交叉引用流的编号排在最后
+    const int perStream = OBJECTS_PER_STREAM;
+    const int streamCount = (packed.size() + perStream - 1) / perStream;
+    const uint32_t firstStreamNumber = uint32_t(order.size()) + 1;
+    const uint32_t xrefNumber = firstStreamNumber + uint32_t(streamCount);
+    QVector<XRefEntry> entries(int(xrefNumber) + 1);
+    entries[0].field3 = 65535;
+
+    DigestWriter writer(device, m_deterministicId);
+
+    // 对象流从 PDF 1.5 开始支持
+    const int version = std::max(int(m_document.GetMetadata().GetPdfVersion()), int(PdfVersion::V1_5));
+    writer.write("%PDF-" + std::to_string(version / 10) + "." + std::to_string(version % 10) + "\n%\xE2\xE3\xCF\xD3\n");
+
+    // 2. 含流的对象：数据保持原样，没有压缩的用 FlateDecode 压缩
+    for (PdfObject* object : direct) {
+        const uint32_t number = numbers.value(UPdfReferenceKey(object->GetIndirectReference())).ObjectNumber();
+        XRefEntry& entry = entries[int(number)];
+        entry.type = 1;
+        entry.field2 = writer.position();
+        writer.write(UPdfSerializeObject(*object, number, numbers, m_compressionLevel));
+    }
+
+    // 3. 对象流：开头是“编号 偏移量”对，/First 之后依次是各对象的值
+    for (int i=0; i<streamCount; i++) {
+        const uint32_t streamNumber = firstStreamNumber + uint32_t(i);
+        const int count = qMin(perStream, packed.size() - i * perStream);
+        std::string header, body;
+        for (int j=0; j<count; j++) {
+            const PdfObject* object = packed[i * perStream + j];
+            const uint32_t number = numbers.value(UPdfReferenceKey(object->GetIndirectReference())).ObjectNumber();
+            PdfObject value(object->GetVariant());
+            UPdfRewriteReferences(value, numbers);
+            header += std::to_string(number) + " " + std::to_string(body.size()) + " ";
+            body += value.GetVariant().ToString();
+            body += '\n';
+
+            XRefEntry& entry = entries[int(number)];
+            entry.type = 2;
+            entry.field2 = streamNumber;
+            entry.field3 = quint16(j);
+        }
+
+        PdfDictionary dictionary;
+        dictionary.AddKey("Type", PdfName("ObjStm"));
+        dictionary.AddKey("N", PdfObject(int64_t(count)));
+        dictionary.AddKey("First", PdfObject(int64_t(header.size())));
+        dictionary.AddKey("Filter", PdfName("FlateDecode"));
+
+        XRefEntry& entry = entries[int(streamNumber)];
+        entry.type = 1;
+        entry.field2 = writer.position();
+        writer.write(UPdfSerializeStream(streamNumber, dictionary,
+                                         UPdfDeflate(QByteArray::fromStdString(header + body), m_compressionLevel)));
+    }
+
+    // 4. 交叉引用流，第二个字段的宽度按最大的偏移量或编号取最小值
+    const quint64 xrefOffset = writer.position();
+    entries[int(xrefNumber)].type = 1;
+    entries[int(xrefNumber)].field2 = xrefOffset;
+    const quint64 maxField = std::max<quint64>(xrefOffset, xrefNumber);
+    int width = 1;
+    while (width < 8 && (maxField >> (8 * width)) != 0)
+        width++;
+
+    QByteArray table;
+    table.reserve(entries.size() * (width + 3));
+    for (const auto& entry : entries) {
+        table.append(char(entry.type));
+        for (int k=width-1; k>=0; k--)
+            table.append(char((entry.field2 >> (8 * k)) & 0xFF));
+        table.append(char(entry.field3 >> 8));
+        table.append(char(entry.field3 & 0xFF));
+    }
+
+    PdfDictionary dictionary;
+    dictionary.AddKey("Type", PdfName("XRef"));
+    dictionary.AddKey("Size", PdfObject(int64_t(entries.size())));
+    PdfArray widths;
+    widths.Add(PdfObject(int64_t(1)));
+    widths.Add(PdfObject(int64_t(width)));
+    widths.Add(PdfObject(int64_t(2)));
+    dictionary.AddKey("W", widths);
+    for (const char* key : { "Root", "Info", "ID" }) {
+        const PdfObject* value = trailer.GetDictionary().GetKey(key);
+        if (value == nullptr)
+            continue;
+        PdfObject copy(*value);
+        UPdfRewriteReferences(copy, numbers);
+        dictionary.AddKey(key, copy);
+    }
+    if (m_deterministicId) {
+        // 文件标识符取之前写入的全部内容的摘要，相同的内容得到相同的标识符
+        const QByteArray digest = writer.digest();
+        PdfArray id;
+        id.Add(PdfString(charbuff(digest.constData(), size_t(digest.size())), true));
+        id.Add(PdfString(charbuff(digest.constData(), size_t(digest.size())), true));
+        dictionary.AddKey("ID", id);
+    }
+    dictionary.AddKey("Filter", PdfName("FlateDecode"));
+    writer.write(UPdfSerializeStream(xrefNumber, dictionary, UPdfDeflate(table, m_compressionLevel)));
+    writer.write("startxref\n" + std::to_string(xrefOffset) + "\n%%EOF\n");
+    device.Flush();
+
+    m_packedObjectCount = packed.size();
+    m_objectStreamCount = streamCount;
+}
@@ -0,0 +1,232 @@
+#include "editjournal.h"
+#include "editmodel.h"
+
+#include <QDataStream>
+#include <QFileInfo>
+#include <QMap>
+#include <QSaveFile>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const quint32 JournalMagic = 0x55504A31;   // "UPJ1"
+
+// 文件头：原文件的大小和修改时间，用于判断日志是否仍然适用
+struct EditJournal::Header {
+    quint32 magic = JournalMagic;
+    qint64 sourceSize = -1;
+    qint64 sourceModified = 0;  // ms since epoch
+};
+
+// 日志中的一条记录：修改后文本的完整状态
+struct JournalRecord {
+    QString text;
+    QPointF pos;
+    QFont font;
+};
+
+// 把已写入的数据同步到磁盘，QFile::flush() 只保证写入了操作系统的缓存
+static void SyncFile(QFile &file)
+{
+#ifdef Q_OS_WIN
+    _commit(file.handle());
+#else
+    ::fsync(file.handle());
+#endif
+}
+
+EditJournal::EditJournal(EditModel *model, QObject *parent)
+    : QObject(parent), m_model(model)
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(FLUSH_INTERVAL_MS);
+    connect(&m_flushTimer, &QTimer::timeout, this, &EditJournal::flush);
+    connect(m_model, &EditModel::runChanged, this, &EditJournal::onRunChanged);
+}
+
+EditJournal::~EditJournal()
+{
+    flush();
+}
+
+QString EditJournal::journalFileName(const QString &fileName)
+{
+    return fileName + ".journal";
+}
+
+bool EditJournal::readHeader(QFile &file, Header &header)
+{
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_15);
+    in >> header.magic >> header.sourceSize >> header.sourceModified;
+    return in.status() == QDataStream::Ok && header.magic == JournalMagic;
+}
+
+EditJournal::Header EditJournal::sourceHeader(const QString &fileName)
+{
+    const QFileInfo info(fileName);
+    Header header;
+    header.sourceSize = info.size();
+    header.sourceModified = info.lastModified().toMSecsSinceEpoch();
+    return header;
+}
+
+bool EditJournal::isRecoverable(const QString &fileName)
+{
+    QFile file(journalFileName(fileName));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    Header header;
+    const Header source = sourceHeader(fileName);
+    // 只有文件头、没有记录的日志不需要恢复
+    return readHeader(file, header) && !file.atEnd()
+            && header.sourceSize == source.sourceSize && header.sourceModified == source.sourceModified;
+}
+
+int EditJournal::replay()
+{
+    const QString fileName = m_model->fileName();
+    if (!isRecoverable(fileName))
+        return 0;
+    QFile file(journalFileName(fileName));
+    Header header;
+    if (!file.open(QIODevice::ReadOnly) || !readHeader(file, header))
+        return 0;
+
+    // 每段文本只需要最后的状态
+    QMap<EditRunIndex, JournalRecord> records;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_15);
+    while (!in.atEnd()) {
+        quint32 size = 0;
+        quint16 checksum = 0;
+        in >> size >> checksum;
+        if (in.status() != QDataStream::Ok || qint64(size) > file.bytesAvailable())
+            break;
+        QByteArray payload(int(size), Qt::Uninitialized);
+        if (in.readRawData(payload.data(), payload.size()) != payload.size()
+                || qChecksum(payload.constData(), uint(payload.size())) != checksum)
+            break;
+
+        QDataStream recordIn(payload);
+        recordIn.setVersion(QDataStream::Qt_5_15);
+        qint32 pageIndex = -1, runIndex = -1;
+        JournalRecord record;
+        recordIn >> pageIndex >> runIndex >> record.text >> record.pos >> record.font;
+        if (recordIn.status() != QDataStream::Ok)
+            break;
+        records.insert(EditRunIndex(pageIndex, runIndex), record);
+    }
+
+    int count = 0;
+    for (auto it = records.cbegin(); it != records.cend(); ++it) {
+        const EditRunIndex& index = it.key();
+        if (index.first < 0 || index.first >= m_model->pageCount()
+                || index.second < 0 || index.second >= m_model->pageRuns(index.first).size())
+            continue;
+        const UPdfTextRun& run = m_model->run(index).run;
+        const JournalRecord& record = it.value();
+        if (run.text != record.text)
+            m_model->setText(index, record.text);
+        if (run.pos != record.pos)
+            m_model->setPos(index, record.pos);
+        if (run.font != record.font)
+            m_model->setFont(index, record.font);
+        count++;
+    }
+    return count;
+}
+
+bool EditJournal::start()
+{
+    m_flushTimer.stop();
+    m_pending.clear();
+    m_file.close();
+
+    const QString fileName = m_model->fileName();
+    if (fileName.isEmpty())
+        return false;
+
+    // 先写入临时文件再替换，重新开始时崩溃也不会丢失旧的日志
+    m_file.setFileName(journalFileName(fileName));
+    {
+        QSaveFile file(m_file.fileName());
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << "EditJournal::start() >>" << file.errorString();
+            return false;
+        }
+        const Header header = sourceHeader(fileName);
+        QDataStream out(&file);
+        out.setVersion(QDataStream::Qt_5_15);
+        out << header.magic << header.sourceSize << header.sourceModified;
+        for (const auto& index : m_model->dirtyRuns())
+            append(index.first, index.second);
+        file.write(m_pending);
+        m_pending.clear();
+        if (!file.commit()) {
+            qWarning() << "EditJournal::start() >>" << file.errorString();
+            return false;
+        }
+    }
+
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "EditJournal::start() >>" << m_file.errorString();
+        return false;
+    }
+    SyncFile(m_file);
+    return true;
+}
+
+void EditJournal::flush()
+{
+    m_flushTimer.stop();
+    if (!m_file.isOpen() || m_pending.isEmpty())
+        return;
+    m_file.write(m_pending);
+    m_pending.clear();
+    m_file.flush();
+    SyncFile(m_file);
+}
+
+void EditJournal::stop()
+{
+    m_flushTimer.stop();
+    m_pending.clear();
+    if (!m_file.isOpen())
+        return;
+    m_file.close();
+    m_file.remove();
+}
+
+void EditJournal::onRunChanged(int pageIndex, int runIndex)
+{
+    if (!m_file.isOpen())
+        return;
+    append(pageIndex, runIndex);
+
+    // 修改较多时立即写入，否则等一段时间一起写入
+    if (m_pending.size() >= MAX_PENDING_BYTES)
+        flush();
+    else if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void EditJournal::append(int pageIndex, int runIndex)
+{
+    const UPdfTextRun& run = m_model->run(EditRunIndex(pageIndex, runIndex)).run;
+    QByteArray payload;
+    {
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_15);
+        out << qint32(pageIndex) << qint32(runIndex) << run.text << run.pos << run.font;
+    }
+
+    // 记录长度和校验和在前，恢复时据此丢弃写了一半的记录
+    QDataStream out(&m_pending, QIODevice::WriteOnly | QIODevice::Append);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << quint32(payload.size()) << qChecksum(payload.constData(), uint(payload.size()));
+    out.writeRawData(payload.constData(), payload.size());
+}
@@ -0,0 +1,1273 @@
+#include "editmodel.h"
+#include "compactwriter.h"
+#include "fontresolver.h"
+#include "imagedownsampler.h"
+#include "incrementalwriter.h"
+#include "linearizedwriter.h"
+#include "qiodevicestream.h"
+#include "streamdeduplicator.h"
+
+#include <QFile>
+#include <QMap>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QUndoCommand>
+#include <QUndoStack>
+#include <QDebug>
+
+#include <algorithm>
+
+#include <podofo/podofo.h>
+
+using namespace PoDoFo;
+
+// 命令的 id，用于合并连续的修改
+enum EditCommandId {
+    EditTextId = 1,
+    EditPosId,
+};
+
+// 文本修改：只记录被替换的一段，连续输入或删除合并为一步
+class EditTextCommand : public QUndoCommand
+{
+public:
+    EditTextCommand(EditModel *model, const EditRunIndex &index, const QString &oldText, const QString &newText)
+        : m_model(model), m_index(index)
+    {
+        // 去掉相同的前缀和后缀，剩下的就是被替换的部分
+        int prefix = 0;
+        const int maxPrefix = qMin(oldText.length(), newText.length());
+        while (prefix < maxPrefix && oldText[prefix] == newText[prefix])
+            prefix++;
+        int suffix = 0;
+        const int maxSuffix = maxPrefix - prefix;
+        while (suffix < maxSuffix && oldText[oldText.length()-1-suffix] == newText[newText.length()-1-suffix])
+            suffix++;
+
+        m_position = prefix;
+        m_removed = oldText.mid(prefix, oldText.length() - prefix - suffix);
+        m_inserted = newText.mid(prefix, newText.length() - prefix - suffix);
+        setText(QObject::tr("Edit Text"));
+    }
+
+    int id() const override { return EditTextId; }
+
+    void undo() override
+    {
+        QString& text = m_model->editRun(m_index).run.text;
+        text.replace(m_position, m_inserted.length(), m_removed);
+        m_model->markChanged(m_index);
+    }
+
+    void redo() override
+    {
+        QString& text = m_model->editRun(m_index).run.text;
+        text.replace(m_position, m_removed.length(), m_inserted);
+        m_model->markChanged(m_index);
+    }
+
+    bool mergeWith(const QUndoCommand *other) override
+    {
+        auto command = static_cast<const EditTextCommand *>(other);
+        if (command->m_index != m_index)
+            return false;
+        // 连续输入
+        if (m_removed.isEmpty() && command->m_removed.isEmpty()
+                && command->m_position == m_position + m_inserted.length()) {
+            m_inserted += command->m_inserted;
+            return true;
+        }
+        // 连续退格
+        if (m_inserted.isEmpty() && command->m_inserted.isEmpty()
+                && command->m_position + command->m_removed.length() == m_position) {
+            m_position = command->m_position;
+            m_removed.prepend(command->m_removed);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    EditModel *m_model;
+    EditRunIndex m_index;
+    int m_position;
+    QString m_removed;
+    QString m_inserted;
+};
+
+// 移动文本：同一次拖动中对同一段文本的移动合并为一步
+class EditPosCommand : public QUndoCommand
+{
+public:
+    EditPosCommand(EditModel *model, const EditRunIndex &index, const QPointF &oldPos, const QPointF &newPos, int gesture)
+        : m_model(model), m_index(index), m_oldPos(oldPos), m_newPos(newPos), m_gesture(gesture)
+    {
+        setText(QObject::tr("Move Text"));
+    }
+
+    int id() const override { return EditPosId; }
+    void undo() override { apply(m_oldPos); }
+    void redo() override { apply(m_newPos); }
+
+    bool mergeWith(const QUndoCommand *other) override
+    {
+        auto command = static_cast<const EditPosCommand *>(other);
+        if (m_gesture == 0 || command->m_gesture != m_gesture || command->m_index != m_index)
+            return false;
+        m_newPos = command->m_newPos;
+        return true;
+    }
+
+private:
+    void apply(const QPointF &pos)
+    {
+        m_model->editRun(m_index).run.pos = pos;
+        m_model->markChanged(m_index);
+    }
+
+    EditModel *m_model;
+    EditRunIndex m_index;
+    QPointF m_oldPos;
+    QPointF m_newPos;
+    int m_gesture;
+};
+
+// 修改字体：QFont 隐式共享，保存新旧两份只增加引用计数；每次修改单独一步
+class EditFontCommand : public QUndoCommand
+{
+public:
+    EditFontCommand(EditModel *model, const EditRunIndex &index, const QFont &oldFont, const QFont &newFont)
+        : m_model(model), m_index(index), m_oldFont(oldFont), m_newFont(newFont)
+    {
+        setText(QObject::tr("Change Font"));
+    }
+
+    void undo() override { apply(m_oldFont); }
+    void redo() override { apply(m_newFont); }
+
+private:
+    void apply(const QFont &font)
+    {
+        m_model->editRun(m_index).run.font = font;
+        m_model->markChanged(m_index);
+    }
+
+    EditModel *m_model;
+    EditRunIndex m_index;
+    QFont m_oldFont;
+    QFont m_newFont;
+};
+
+// 保存时使用的快照：修改过的页面的全部文本，QVector/QString 隐式共享，复制只增加引用计数
+struct EditModel::SaveSnapshot {
+    std::shared_ptr<PdfMemDocument> document;
+    QString fileName;
+    QString sourceFileName;
+    QVector<EditRunIndex> dirtyRuns;
+    QMap<int, QVector<EditRun>> pages;
+    QVector<int> extractedPages;
+    // 各页叠加表单的名称和画在表单中的文本，保存线程中加入新的叠加
+    QMap<int, QByteArray> overlays;
+    QMap<int, QSet<int>> overlaidRuns;
+    int compressionLevel = -1;
+    bool compact = false;
+    bool optimize = false;
+    bool reproducible = false;
+    bool linearize = false;
+    bool downsample = false;
+    int targetDpi = ImageDownsampler::DEFAULT_TARGET_DPI;
+    int jpegQuality = ImageDownsampler::DEFAULT_JPEG_QUALITY;
+    // 优化和缩小图片时各类对象节省的字节数
+    QMap<QString, qint64> savedBytes;
+
+    // 增量更新：新对象的起始编号，保存后为新的文件尾中的 /Size
+    uint32_t nextObjectNumber = 0;
+    // 写入的内容流（已压缩）和加入叠加表单的页面资源，保存到原文件后应用到内存中的文档
+    QVector<QPair<PdfReference, QByteArray>> contents;
+    QMap<int, PdfObject> resources;
+
+    // 完整重写原文件后重新加载的文档，以及已提取页面在新文档中的文本状态
+    std::shared_ptr<PdfMemDocument> reloaded;
+    QMap<int, std::vector<UPdfTextState>> states;
+
+    // 导出文本层：pages 为所有已提取页面的文本，其余页面导出时临时提取
+    bool textLayer = false;
+    QVector<QRectF> trimBoxes;
+
+    bool succeeded = false;
+    QString message;
+};
+
+// 取消保存时从写入回调中抛出，中断 IncrementalWriter 或 CompactWriter
+struct SaveCancelled {};
+
+EditModel::EditModel(QObject *parent)
+    : QObject(parent)
+    , m_nextObjectNumber(0)
+    , m_undoStack(new QUndoStack(this))
+    , m_lastGesture(0)
+    , m_saving(false)
+    , m_cancelSave(false)
+    , m_compressionLevel(DEFAULT_COMPRESSION_LEVEL)
+    , m_compactSave(false)
+    , m_optimizeSave(false)
+    , m_reproducibleSave(false)
+    , m_linearizeSave(false)
+    , m_downsampleImages(false)
+    , m_imageTargetDpi(ImageDownsampler::DEFAULT_TARGET_DPI)
+    , m_jpegQuality(ImageDownsampler::DEFAULT_JPEG_QUALITY)
+{
+    m_undoStack->setUndoLimit(UNDO_LIMIT);
+}
+
+EditModel::~EditModel()
+{
+    // 保存线程持有文档的引用，取消后即可退出，不会访问已释放的模型
+    cancelSave();
+    QThreadPool::globalInstance()->waitForDone();
+}
+
+void EditModel::load(const QString &fileName)
+{
+    auto document = std::make_shared<PdfMemDocument>();
+    qDebug() << fileName;
+    document->Load(fileName.toStdString());
+
+    // 只读取页面尺寸，文本在第一次访问时才提取
+    auto& pages = document->GetPages();
+    QVector<Page> pageSlots(pages.GetCount());
+    for (int i=0; i<pageSlots.size(); i++) {
+        // TrimBox 定义了页面最终的尺寸
+        auto&& trimBox = pages.GetPageAt(i).GetTrimBox();
+        pageSlots[i].trimBox = QRectF(trimBox.GetLeft(), trimBox.GetBottom(), trimBox.Width, trimBox.Height);
+    }
+
+    // 正在保存的旧文档由保存线程继续持有，保存结果不再应用到模型
+    cancelSave();
+    m_saving = false;
+    m_document = std::move(document);
+    m_nextObjectNumber = 0;
+    m_fileName = fileName;
+    m_pages = pageSlots;
+    m_dirtyRuns.clear();
+    // 命令引用旧文档的文本，切换文档后作废
+    m_undoStack->clear();
+    emit modelReset();
+}
+
+void EditModel::clear()
+{
+    cancelSave();
+    m_saving = false;
+    m_document.reset();
+    m_nextObjectNumber = 0;
+    m_fileName.clear();
+    m_pages.clear();
+    m_dirtyRuns.clear();
+    m_undoStack->clear();
+    emit modelReset();
+}
+
+QRectF EditModel::pageTrimBox(int pageIndex) const
+{
+    return m_pages.value(pageIndex).trimBox;
+}
+
+const QVector<EditRun>& EditModel::pageRuns(int pageIndex)
+{
+    extractPage(pageIndex);
+    return m_pages[pageIndex].runs;
+}
+
+const EditRun& EditModel::run(const EditRunIndex &index) const
+{
+    return m_pages[index.first].runs[index.second];
+}
+
+void EditModel::setText(const EditRunIndex &index, const QString &text)
+{
+    const UPdfTextRun& run = editRun(index).run;
+    // 修改字体等操作也会触发编辑框的 textChanged，内容相同时忽略
+    if (run.text == text)
+        return;
+    m_undoStack->push(new EditTextCommand(this, index, run.text, text));
+}
+
+void EditModel::setPos(const EditRunIndex &index, const QPointF &pos, int gesture)
+{
+    const UPdfTextRun& run = editRun(index).run;
+    if (run.pos == pos)
+        return;
+    m_undoStack->push(new EditPosCommand(this, index, run.pos, pos, gesture));
+}
+
+void EditModel::setFont(const EditRunIndex &index, const QFont &font)
+{
+    const UPdfTextRun& run = editRun(index).run;
+    if (run.font == font)
+        return;
+    m_undoStack->push(new EditFontCommand(this, index, run.font, font));
+}
+
+int EditModel::beginGesture()
+{
+    // 0 保留给不属于任何操作的修改
+    if (++m_lastGesture <= 0)
+        m_lastGesture = 1;
+    return m_lastGesture;
+}
+
+QVector<EditRunIndex> EditModel::dirtyRuns() const
+{
+    QVector<EditRunIndex> runs(m_dirtyRuns.cbegin(), m_dirtyRuns.cend());
+    std::sort(runs.begin(), runs.end());
+    return runs;
+}
+
+// 等待压缩的内容流
+struct PendingStream {
+    PdfReference ref;
+    PdfDictionary dictionary;   // 写入时设置 /Filter
+    charbuff data;
+    QByteArray compressed;
+};
+
+// 可以在内容流中直接替换的 Tj/TJ 运算对象
+struct OperandPatch {
+    qint64 offset;
+    qint64 length;
+    std::string operand;
+    int runIndex;
+    double width;       // 新文本的宽度（pt）
+};
+
+// 保存线程使用的页面副本：从文档中复制，之后只修改副本，内存中的文档保持不变
+struct PageCopy {
+    int pageIndex;
+    PdfReference ref;
+    PdfObject page;                     // 页面字典
+    PdfReference contentsRef;           // 只有一个内容流时有效
+    PdfDictionary contentsDictionary;
+    charbuff contents;                  // 解码后的内容
+    PdfArray contentsArray;             // 多个内容流时的 /Contents
+    PdfObject resources;                // 页面实际使用的资源字典（包括继承的），/XObject 已解引用
+    Rect bbox;
+    std::string overlayName;            // 已有的叠加表单在资源中的名称，没有时为空
+    PdfReference overlay;
+    QVector<OperandPatch> patches;
+    QVector<int> overlaid;              // 无法直接替换、需要叠加绘制的文本
+};
+
+// 子集字体（BaseFont 以 6 个大写字母和 + 开头）只嵌入了原文本用到的字形，编码中有的字符不一定有字形
+static bool IsSubsetFont(const PdfFont &font)
+{
+    const PdfObject* value = font.GetObject().GetDictionary().FindKey("BaseFont");
+    const PdfName* name = nullptr;
+    if (value == nullptr || !value->TryGetName(name))
+        return false;
+    const std::string& baseFont = name->GetString();
+    return baseFont.size() > 7 && baseFont[6] == '+'
+            && std::all_of(baseFont.begin(), baseFont.begin() + 6, [](char c) { return c >= 'A' && c <= 'Z'; });
+}
+
+// 子集字体中确定有字形的字符：本页使用同一字体、运算对象仍在内容流中的文本
+static QSet<QChar> SubsetCharacters(const QVector<EditRun> &runs, const PdfFont *font)
+{
+    QSet<QChar> characters;
+    for (const auto& editRun : runs) {
+        if (editRun.run.pdfFont != font || editRun.run.operandOffset < 0)
+            continue;
+        for (QChar c : editRun.original.text)
+            characters.insert(c);
+    }
+    return characters;
+}
+
+// 复制页面和内容，并找出可以直接替换的文本
+// 新文本用原字体编码，需要访问文档中的字体，也在这里完成
+static void CopyPage(PdfPage &page, const QVector<EditRun> &runs, const QVector<int> &runIndexes,
+                     const QByteArray &overlayName, PageCopy &copy)
+{
+    copy.ref = page.GetObject().GetIndirectReference();
+    copy.page = PdfObject(page.GetDictionary());
+    copy.bbox = page.GetMediaBox(true);
+
+    PdfDictionary resources;
+    const PdfObject* value = page.GetDictionary().FindKeyParent("Resources");
+    if (value != nullptr && value->IsDictionary()) {
+        resources = value->GetDictionary();
+        const PdfObject* xobjects = value->GetDictionary().FindKey("XObject");
+        if (xobjects != nullptr && xobjects->IsDictionary()) {
+            resources.AddKey("XObject", PdfObject(xobjects->GetDictionary()));
+            // 按名称查找，完整重写文件后对象编号改变也能找到
+            const std::string name = overlayName.toStdString();
+            const PdfObject* overlay = name.empty() ? nullptr : xobjects->GetDictionary().GetKey(name);
+            if (overlay != nullptr && overlay->TryGetReference(copy.overlay))
+                copy.overlayName = name;
+        }
+    }
+    copy.resources = PdfObject(resources);
+
+    const PdfArray* array = nullptr;
+    value = page.GetDictionary().FindKey("Contents");
+    if (value != nullptr && value->HasStream()) {
+        copy.contentsRef = value->GetIndirectReference();
+        copy.contentsDictionary = value->GetDictionary();
+        copy.contents = value->GetStream()->GetCopy();
+    }
+    else if (value != nullptr && value->TryGetArray(array)) {
+        copy.contentsArray = *array;
+    }
+
+    // 提取时记录的是拼接后的位置，多个内容流的页面无法对应回单个流
+    if (!copy.contentsRef.IsIndirect()) {
+        copy.overlaid = runIndexes;
+        return;
+    }
+    QHash<const PdfFont*, QSet<QChar>> subsets;
+    for (int runIndex : runIndexes) {
+        const EditRun& editRun = runs[runIndex];
+        const UPdfTextRun& run = editRun.run;
+
+        // 只修改了文本内容才能直接替换；位置、字体改变或多行文本需要重新绘制
+        // 新文本要能用原字体的编码表示
+        charbuff encoded;
+        if (run.operandOffset < 0 || run.operandOffset + run.operandLength > qint64(copy.contents.size())
+                || run.pos != editRun.original.pos || run.font != editRun.original.font
+                || run.text.contains('\n')
+                || !run.pdfFont->GetEncoding().TryConvertToEncoded(run.text.toStdString(), encoded)) {
+            copy.overlaid.append(runIndex);
+            continue;
+        }
+        // 子集字体缺少字形的文本叠加绘制
+        if (IsSubsetFont(*run.pdfFont)) {
+            auto subset = subsets.find(run.pdfFont);
+            if (subset == subsets.end())
+                subset = subsets.insert(run.pdfFont, SubsetCharacters(runs, run.pdfFont));
+            if (!std::all_of(run.text.begin(), run.text.end(), [&](QChar c) { return subset->contains(c); })) {
+                copy.overlaid.append(runIndex);
+                continue;
+            }
+        }
+
+        // 用十六进制字符串避免转义；TJ 的运算对象替换为只有一个字符串的数组
+        std::string operand = PdfVariant(PdfString(std::move(encoded), true)).ToString();
+        if (copy.contents[size_t(run.operandOffset)] == '[')
+            operand = "[" + operand + "]";
+
+        // 新文本可能比原文本长，之后叠加绘制时要一起遮盖
+        PdfTextState state;
+        state.Font = run.pdfFont;
+        state.FontSize = run.font.pointSizeF();
+        const double width = run.pdfFont->GetStringLength(run.text.toStdString(), state);
+        OperandPatch patch = { run.operandOffset, run.operandLength, operand, runIndex, width };
+        copy.patches.append(patch);
+    }
+}
+
+// 在内容流的副本中替换运算对象，同一页其他文本的位置随替换的长度平移
+static void ApplyPatches(PageCopy &copy, QVector<EditRun> &runs)
+{
+    QVector<OperandPatch>& patches = copy.patches;
+    if (patches.isEmpty())
+        return;
+
+    // 从后往前替换，前面的位置不受影响
+    std::sort(patches.begin(), patches.end(), [](const OperandPatch& a, const OperandPatch& b) { return a.offset < b.offset; });
+    for (int i=patches.size()-1; i>=0; i--)
+        copy.contents.replace(size_t(patches[i].offset), size_t(patches[i].length), patches[i].operand);
+
+    for (auto& editRun : runs) {
+        UPdfTextRun& run = editRun.run;
+        if (run.operandOffset < 0)
+            continue;
+        qint64 shift = 0;
+        for (const auto& patch : patches) {
+            if (patch.offset >= run.operandOffset)
+                break;
+            shift += qint64(patch.operand.size()) - patch.length;
+        }
+        run.operandOffset += shift;
+    }
+    for (const auto& patch : patches) {
+        UPdfTextRun& run = runs[patch.runIndex].run;
+        run.operandLength = qint64(patch.operand.size());
+        run.bounds.setWidth(qMax(run.bounds.width(), patch.width));
+    }
+}
+
+// 页面第一次叠加绘制：资源中加入表单，原内容包在 q/Q 中，最后绘制表单
+// 只有一个内容流时直接改写该流，其中文本的运算对象之后仍然可以直接替换；多个内容流时在前后各加一个流
+static void AddOverlay(PageCopy &copy, const PdfReference &form, QVector<EditRun> &runs, IncrementalWriter &writer)
+{
+    // 表单的名称不能与页面已有的 XObject 重复
+    PdfDictionary& resources = copy.resources.GetDictionary();
+    if (resources.GetKey("XObject") == nullptr || !resources.GetKey("XObject")->IsDictionary())
+        resources.AddKey("XObject", PdfDictionary());
+    PdfDictionary& xobjects = resources.GetKey("XObject")->GetDictionary();
+    std::string name = "UPdfOverlay";
+    for (int i=2; xobjects.HasKey(name); i++)
+        name = "UPdfOverlay" + std::to_string(i);
+    xobjects.AddKey(PdfName(name), PdfObject(form));
+    copy.overlayName = name;
+    copy.overlay = form;
+
+    PdfDictionary& page = copy.page.GetDictionary();
+    page.AddKey("Resources", copy.resources);
+    const std::string prefix = "q\n";
+    const std::string suffix = "\nQ\nq /" + name + " Do Q\n";
+    if (copy.contentsRef.IsIndirect()) {
+        copy.contents.insert(0, prefix);
+        copy.contents.append(suffix);
+        for (auto& editRun : runs) {
+            if (editRun.run.operandOffset >= 0)
+                editRun.run.operandOffset += qint64(prefix.size());
+        }
+    }
+    else {
+        const PdfReference before = writer.createObject();
+        const PdfReference after = writer.createObject();
+        writer.setStream(before, PdfDictionary(), QByteArray::fromStdString(prefix));
+        writer.setStream(after, PdfDictionary(), QByteArray::fromStdString(suffix));
+        PdfArray contents;
+        contents.Add(PdfObject(before));
+        for (const auto& item : copy.contentsArray)
+            contents.Add(item);
+        contents.Add(PdfObject(after));
+        page.AddKey("Contents", contents);
+    }
+    writer.setObject(copy.ref, copy.page);
+}
+
+// 去掉之前保存时加入的叠加表单，恢复 AddOverlay 之前的内容，之后与第一次叠加一样新建表单
+static void StripOverlay(PageCopy &copy, QVector<EditRun> &runs)
+{
+    PdfDictionary& resources = copy.resources.GetDictionary();
+    resources.GetKey("XObject")->GetDictionary().RemoveKey(copy.overlayName);
+    copy.page.GetDictionary().AddKey("Resources", copy.resources);
+
+    const std::string prefix = "q\n";
+    const std::string suffix = "\nQ\nq /" + copy.overlayName + " Do Q\n";
+    if (copy.contentsRef.IsIndirect()) {
+        charbuff& contents = copy.contents;
+        if (contents.size() >= prefix.size() + suffix.size() && contents.compare(0, prefix.size(), prefix) == 0
+                && contents.compare(contents.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            contents.erase(contents.size() - suffix.size());
+            contents.erase(0, prefix.size());
+            for (auto& editRun : runs) {
+                if (editRun.run.operandOffset >= 0)
+                    editRun.run.operandOffset -= qint64(prefix.size());
+            }
+        }
+    }
+    else if (copy.contentsArray.size() >= 2) {
+        // 去掉前后各加的一个流
+        PdfArray contents;
+        for (unsigned i=1; i+1<copy.contentsArray.size(); i++)
+            contents.Add(copy.contentsArray[i]);
+        copy.contentsArray = contents;
+        copy.page.GetDictionary().AddKey("Contents", contents);
+    }
+    copy.overlayName.clear();
+    copy.overlay = PdfReference();
+}
+
+// 把临时文档中的表单及其引用的字体等对象复制到增量更新中
+// forms 为 (临时文档中的编号, 写入的编号)，其余对象按引用的顺序分配新编号
+// 未压缩或以 FlateDecode 压缩的流解码后加入 streams，和内容流一起按设定的级别压缩
+static void ImportForms(PdfDocument &scratch, const QVector<QPair<PdfReference, PdfReference>> &forms,
+                        QVector<PendingStream> &streams, IncrementalWriter &writer)
+{
+    QHash<quint64, PdfReference> numbers;
+    QVector<PdfReference> pending;
+    for (const auto& form : forms) {
+        numbers.insert(UPdfReferenceKey(form.first), form.second);
+        pending.append(form.first);
+    }
+    QVector<PdfObject*> objects;
+    QSet<quint64> visited;
+    for (int i=0; i<pending.size(); i++) {
+        const quint64 key = UPdfReferenceKey(pending[i]);
+        if (visited.contains(key))
+            continue;
+        visited.insert(key);
+        PdfObject* object = scratch.GetObjects().GetObject(pending[i]);
+        if (object == nullptr)
+            continue;
+        if (!numbers.contains(key))
+            numbers.insert(key, writer.createObject());
+        objects.append(object);
+        UPdfCollectReferences(*object, pending);
+    }
+
+    for (PdfObject* object : objects) {
+        const PdfReference ref = numbers.value(UPdfReferenceKey(object->GetIndirectReference()));
+        if (object->HasStream()) {
+            PdfObject dictionary(object->GetDictionary());
+            UPdfRewriteReferences(dictionary, numbers);
+            const PdfObject* filter = dictionary.GetDictionary().GetKey("Filter");
+            const PdfName* name = nullptr;
+            if (filter == nullptr || (filter->TryGetName(name) && *name == "FlateDecode")) {
+                PendingStream stream;
+                stream.ref = ref;
+                stream.dictionary = dictionary.GetDictionary();
+                stream.data = object->GetStream()->GetCopy();
+                streams.append(std::move(stream));
+                continue;
+            }
+            const charbuff raw = object->GetStream()->GetCopy(true);
+            writer.setStream(ref, dictionary.GetDictionary(), QByteArray(raw.data(), int(raw.size())));
+        }
+        else {
+            PdfObject value(object->GetVariant());
+            UPdfRewriteReferences(value, numbers);
+            writer.setObject(ref, value);
+        }
+    }
+}
+
+// 文档中最大的对象编号加 1，新对象从这里开始编号
+static uint32_t ObjectNumberLimit(PdfMemDocument &document)
+{
+    uint32_t limit = 1;
+    int64_t size = 0;
+    const PdfObject* value = document.GetTrailer().GetDictionary().GetKey("Size");
+    if (value != nullptr && value->TryGetNumber(size) && size > 0)
+        limit = uint32_t(size);
+    for (const PdfObject* object : document.GetObjects())
+        limit = std::max(limit, object->GetIndirectReference().ObjectNumber() + 1);
+    for (const auto& ref : document.GetObjects().GetFreeObjects())
+        limit = std::max(limit, ref.ObjectNumber() + 1);
+    return limit;
+}
+
+// 更新文档信息字典中的修改时间
+static void UpdateModDate(PdfMemDocument &document, IncrementalWriter &writer)
+{
+    PdfReference ref;
+    const PdfObject* value = document.GetTrailer().GetDictionary().GetKey("Info");
+    if (value == nullptr || !value->TryGetReference(ref))
+        return;
+    const PdfObject* info = document.GetObjects().GetObject(ref);
+    if (info == nullptr || !info->IsDictionary())
+        return;
+    PdfObject copy(info->GetDictionary());
+    copy.GetDictionary().AddKey("ModDate", PdfObject(PdfDate::LocalNow().ToString()));
+    writer.setObject(ref, copy);
+}
+
+// 在线程池中并行压缩内容流，每个流独立压缩，按原顺序写回，结果与逐个压缩相同
+static void CompressStreams(QThreadPool &pool, QVector<PendingStream> &streams, int level, IncrementalWriter &writer)
+{
+    for (auto& stream : streams) {
+        PendingStream *pending = &stream;
+        pool.start([pending, level]() {
+            pending->compressed = UPdfDeflate(QByteArray::fromRawData(pending->data.data(), int(pending->data.size())),
+                                              level);
+        });
+    }
+    pool.waitForDone();
+
+    for (auto& stream : streams) {
+        stream.dictionary.RemoveKey("DecodeParms");
+        stream.dictionary.AddKey("Filter", PdfName("FlateDecode"));
+        writer.setStream(stream.ref, stream.dictionary, stream.compressed);
+    }
+}
+
+// 叠加绘制：先用白色矩形盖住原文本，再写入新文本
+static void PaintRuns(FontResolver &fonts, PdfPainter &painter, QVector<EditRun> &runs, const QVector<int> &runIndexes)
+{
+    for (int runIndex : runIndexes) {
+        UPdfTextRun& run = runs[runIndex].run;
+
+        painter.GraphicsState.SetFillColor(PdfColor(1.0, 1.0, 1.0));
+        painter.DrawRectangle(run.bounds.x(), run.bounds.y(), run.bounds.width(), run.bounds.height(),
+                              PdfPathDrawMode::Fill);
+        painter.GraphicsState.SetFillColor(PdfColor(0.0, 0.0, 0.0));
+
+        // 同一种字体在一次保存中只查找一次
+        PdfFont* font = fonts.resolve(run.font);
+        if (font == nullptr)
+            throw PdfError(PdfErrorCode::InvalidFontData, __FILE__, __LINE__,
+                           "Font not found: " + run.font.family().toStdString());
+
+        const std::string text = run.text.toStdString();
+        painter.TextState.SetFont(*font, run.font.pointSizeF());
+        painter.DrawText(text, run.pos.x(), run.pos.y());
+
+        // 写入的文本可能比原文本长，下次修改时要一起遮盖
+        const PdfTextState& state = painter.TextState;
+        const double ascent = font->GetAscent(state), descent = font->GetDescent(state);
+        run.bounds = run.bounds.united(QRectF(run.pos.x(), run.pos.y() + descent,
+                                              font->GetStringLength(text, state), ascent - descent));
+        // 原运算对象已被遮盖，之后的修改都叠加绘制
+        run.operandOffset = -1;
+    }
+}
+
+bool EditModel::save(const QString &fileName)
+{
+    if (!m_document || m_saving)
+        return false;
+
+    auto snapshot = std::make_shared<SaveSnapshot>();
+    snapshot->document = m_document;
+    snapshot->fileName = fileName;
+    snapshot->sourceFileName = m_fileName;
+    snapshot->dirtyRuns = dirtyRuns();
+    snapshot->compressionLevel = m_compressionLevel;
+    snapshot->compact = m_compactSave;
+    snapshot->optimize = m_optimizeSave;
+    snapshot->reproducible = m_reproducibleSave;
+    snapshot->linearize = m_linearizeSave;
+    snapshot->downsample = m_downsampleImages;
+    snapshot->targetDpi = m_imageTargetDpi;
+    snapshot->jpegQuality = m_jpegQuality;
+    snapshot->nextObjectNumber = m_nextObjectNumber;
+    for (const auto& index : snapshot->dirtyRuns) {
+        if (!snapshot->pages.contains(index.first))
+            snapshot->pages.insert(index.first, m_pages[index.first].runs);
+    }
+    for (int i=0; i<m_pages.size(); i++) {
+        if (m_pages[i].extracted)
+            snapshot->extractedPages.append(i);
+        if (!m_pages[i].overlay.isEmpty()) {
+            snapshot->overlays.insert(i, m_pages[i].overlay);
+            snapshot->overlaidRuns.insert(i, m_pages[i].overlaidRuns);
+            // 可重现保存要去掉本次会话中叠加的表单，没有修改的页面也要复制
+            if (m_reproducibleSave && !snapshot->pages.contains(i))
+                snapshot->pages.insert(i, m_pages[i].runs);
+        }
+    }
+
+    m_saving = true;
+    m_cancelSave = false;
+    QThreadPool::globalInstance()->start([this, snapshot]() {
+        writeSnapshot(*snapshot);
+        QMetaObject::invokeMethod(this, [this, snapshot]() {
+            onSaveFinished(snapshot);
+        }, Qt::QueuedConnection);
+    });
+    return true;
+}
+
+bool EditModel::exportTextLayer(const QString &fileName)
+{
+    if (!m_document || m_saving)
+        return false;
+
+    auto snapshot = std::make_shared<SaveSnapshot>();
+    snapshot->document = m_document;
+    snapshot->fileName = fileName;
+    snapshot->sourceFileName = m_fileName;
+    snapshot->textLayer = true;
+    for (int i=0; i<m_pages.size(); i++) {
+        snapshot->trimBoxes.append(m_pages[i].trimBox);
+        if (m_pages[i].extracted)
+            snapshot->pages.insert(i, m_pages[i].runs);
+    }
+
+    m_saving = true;
+    m_cancelSave = false;
+    QThreadPool::globalInstance()->start([this, snapshot]() {
+        writeTextLayer(*snapshot);
+        QMetaObject::invokeMethod(this, [this, snapshot]() {
+            onSaveFinished(snapshot);
+        }, Qt::QueuedConnection);
+    });
+    return true;
+}
+
+void EditModel::cancelSave()
+{
+    m_cancelSave = true;
+}
+
+void EditModel::setCompressionLevel(int level)
+{
+    m_compressionLevel = qBound(-1, level, 9);
+}
+
+void EditModel::writeSnapshot(SaveSnapshot &snapshot)
+{
+    const bool inPlace = snapshot.fileName == snapshot.sourceFileName;
+    const bool rewrite = snapshot.compact || snapshot.optimize || snapshot.reproducible || snapshot.linearize
+            || snapshot.downsample;
+
+    try {
+        // 可重现保存从重新加载的原文件复制页面，结果只取决于原文件和修改，与本次会话中之前的保存无关
+        // 文本的字体仍属于内存中的文档，复制时同样需要锁定
+        std::unique_ptr<PdfMemDocument> source;
+        if (snapshot.reproducible) {
+            source.reset(new PdfMemDocument());
+            source->Load(snapshot.sourceFileName.toStdString());
+        }
+        PdfMemDocument& document = source ? *source : *snapshot.document;
+
+        // 只在复制页面时锁定文档，之后的修改、压缩和写入都在副本上进行，不影响提取页面文本
+        QMutexLocker locker(&m_documentMutex);
+
+        // 1. 复制修改过的页面和内容流，找出可以直接替换的文本
+        QVector<PageCopy> copies;
+        int pageCount = 0;
+        for (auto it = snapshot.pages.begin(); it != snapshot.pages.end(); ++it) {
+            if (m_cancelSave)
+                throw SaveCancelled();
+            QVector<int> runIndexes;
+            for (const auto& index : snapshot.dirtyRuns) {
+                if (index.first == it.key())
+                    runIndexes.append(index.second);
+            }
+            PageCopy copy;
+            copy.pageIndex = it.key();
+            CopyPage(document.GetPages().GetPageAt(it.key()), it.value(), runIndexes,
+                     snapshot.overlays.value(it.key()), copy);
+            // 重新加载的原文件中仍有本次会话之前保存时叠加的表单，去掉后其中的文本重新叠加绘制，
+            // 结果与重新打开文件后保存相同，不会重复叠加
+            if (snapshot.reproducible && copy.overlay.IsIndirect()) {
+                StripOverlay(copy, it.value());
+                for (int runIndex : snapshot.overlaidRuns.value(it.key())) {
+                    if (!copy.overlaid.contains(runIndex))
+                        copy.overlaid.append(runIndex);
+                }
+                snapshot.overlaidRuns.remove(it.key());
+                snapshot.overlays.remove(it.key());
+            }
+            copies.append(std::move(copy));
+            emit saveProgress(5 * ++pageCount / snapshot.pages.size());
+        }
+
+        const PdfEncrypt* encrypt = document.GetEncrypt();
+        IncrementalWriter writer(document.GetTrailer().GetDictionary(),
+                                 std::max(ObjectNumberLimit(document), snapshot.nextObjectNumber),
+                                 encrypt != nullptr ? PdfEncrypt::CreateFromEncrypt(*encrypt) : nullptr);
+        writer.setCompressionLevel(snapshot.compressionLevel);
+        // 可重现保存不更新修改时间等元数据
+        if (!snapshot.reproducible)
+            UpdateModDate(document, writer);
+        locker.unlock();
+
+        // 2. 在副本上替换文本；无法替换的文本画在临时文档的表单中，之后连同字体一起复制到增量更新中
+        //    同一页已有的叠加表单整个重新生成，包括之前保存时叠加的文本
+        PdfMemDocument scratch;
+        FontResolver fonts(scratch);
+        if (snapshot.reproducible)
+            fonts.setCreateFlags(PdfFontCreateFlags::DontSubset);
+        PdfPainter painter;
+        QVector<QPair<PdfReference, PdfReference>> forms;
+        QVector<PendingStream> streams;
+        for (auto& copy : copies) {
+            if (m_cancelSave)
+                throw SaveCancelled();
+            QVector<EditRun>& runs = snapshot.pages[copy.pageIndex];
+            ApplyPatches(copy, runs);
+
+            bool changed = !copy.patches.isEmpty();
+            if (!copy.overlaid.isEmpty()) {
+                QSet<int>& overlaid = snapshot.overlaidRuns[copy.pageIndex];
+                for (int runIndex : copy.overlaid)
+                    overlaid.insert(runIndex);
+                QVector<int> runIndexes(overlaid.begin(), overlaid.end());
+                std::sort(runIndexes.begin(), runIndexes.end());
+
+                auto form = scratch.CreateXObjectForm(copy.bbox);
+                painter.SetCanvas(*form);
+                PaintRuns(fonts, painter, runs, runIndexes);
+                painter.FinishDrawing();
+                if (!copy.overlay.IsIndirect()) {
+                    AddOverlay(copy, writer.createObject(), runs, writer);
+                    snapshot.resources.insert(copy.pageIndex, copy.resources);
+                    changed = true;
+                }
+                forms.append(qMakePair(form->GetObject().GetIndirectReference(), copy.overlay));
+                snapshot.overlays.insert(copy.pageIndex, QByteArray::fromStdString(copy.overlayName));
+            }
+
+            if (changed && copy.contentsRef.IsIndirect()) {
+                PendingStream stream;
+                stream.ref = copy.contentsRef;
+                stream.dictionary = copy.contentsDictionary;
+                stream.data = std::move(copy.contents);
+                streams.append(std::move(stream));
+            }
+        }
+
+        if (m_cancelSave)
+            throw SaveCancelled();
+        const int contentCount = streams.size();
+        if (!forms.isEmpty()) {
+            scratch.GetFonts().EmbedFonts();
+            ImportForms(scratch, forms, streams, writer);
+        }
+        // 修改后的内容流和叠加表单的流在写入前并行压缩
+        CompressStreams(m_compressPool, streams, snapshot.compressionLevel, writer);
+        for (int i=0; i<contentCount; i++)
+            snapshot.contents.append(qMakePair(streams[i].ref, streams[i].compressed));
+        emit saveProgress(10);
+
+        // 3. 保存到原文件的增量更新直接追加到原文件末尾，不复制原文件，取消或失败时截断回原来的大小
+        //    代价是不再原子替换：追加过程中程序崩溃或断电，原文件末尾会残留不完整的更新，
+        //    之前的内容不受影响；另存为和完整重写仍写入临时文件，完成后替换目标文件
+        const bool append = inPlace && !rewrite;
+        QFile source(snapshot.sourceFileName);
+        if (!source.open(append ? QIODevice::ReadWrite : QIODevice::ReadOnly)) {
+            snapshot.message = source.errorString();
+            return;
+        }
+        qint64 expected = source.size();
+        if (append) {
+            expected = 0;
+            for (const auto& stream : streams)
+                expected += stream.compressed.size();
+        }
+        expected = qMax<qint64>(expected, 1);
+        auto progress = [&](qint64 written) {
+            if (m_cancelSave)
+                throw SaveCancelled();
+            emit saveProgress(10 + int(qMin<qint64>(85, 85 * written / expected)));
+        };
+
+        if (append) {
+            const qint64 oldSize = source.size();
+            QIODeviceOutputStream device(source, progress);
+            try {
+                writer.append(source, device);
+                if (m_cancelSave)
+                    throw SaveCancelled();
+                if (!source.flush())
+                    throw PdfError(PdfErrorCode::InvalidDeviceOperation, __FILE__, __LINE__,
+                                   source.errorString().toStdString());
+            }
+            catch (...) {
+                source.resize(oldSize);
+                throw;
+            }
+            snapshot.succeeded = true;
+            snapshot.nextObjectNumber = writer.size();
+            emit saveProgress(SAVE_PROGRESS_MAX);
+            return;
+        }
+
+        QSaveFile file(snapshot.fileName);
+        if (!file.open(QIODevice::WriteOnly)) {
+            snapshot.message = file.errorString();
+            return;
+        }
+        QIODeviceOutputStream device(file, progress);
+        if (rewrite) {
+            // 完整重写会删除对象，先把增量更新写入内存，在重新解析的副本上进行
+            charbuff buffer;
+            {
+                BufferStreamDevice memory(buffer);
+                writer.write(source, memory);
+            }
+            if (m_cancelSave)
+                throw SaveCancelled();
+            PdfMemDocument copy;
+            copy.LoadFromBuffer(buffer);
+
+            if (snapshot.optimize) {
+                StreamDeduplicator deduplicator(copy);
+                deduplicator.run();
+                snapshot.savedBytes = deduplicator.savedBytes();
+            }
+            // 在合并之后进行，相同的图片只编码一次
+            if (snapshot.downsample) {
+                if (m_cancelSave)
+                    throw SaveCancelled();
+                ImageDownsampler downsampler(copy);
+                downsampler.setTargetDpi(snapshot.targetDpi);
+                downsampler.setJpegQuality(snapshot.jpegQuality);
+                if (downsampler.run() > 0)
+                    snapshot.savedBytes.insert("Downsampled images", downsampler.savedBytes());
+            }
+            // 线性化优先；可重现保存默认使用紧凑格式，两种格式的编号都只取决于内容，文件标识符取内容的摘要
+            if (snapshot.linearize) {
+                LinearizedWriter linearized(copy);
+                linearized.setCompressionLevel(snapshot.compressionLevel);
+                linearized.setDeterministicId(snapshot.reproducible);
+                linearized.write(device);
+            }
+            else if (snapshot.compact || snapshot.reproducible) {
+                CompactWriter compact(copy);
+                compact.setCompressionLevel(snapshot.compressionLevel);
+                compact.setDeterministicId(snapshot.reproducible);
+                compact.write(device);
+            }
+            else {
+                copy.Save(device);
+            }
+        }
+        else {
+            writer.write(source, device);
+        }
+        if (m_cancelSave)
+            throw SaveCancelled();
+        if (!file.commit()) {
+            snapshot.message = file.errorString();
+            return;
+        }
+        snapshot.succeeded = true;
+
+        snapshot.nextObjectNumber = writer.size();
+
+        // 4. 保存到原文件后，之后的保存以新文件为基础
+        //    增量更新只追加了对象，在 onSaveFinished 中把写入的内容应用到内存中的文档，不需要重新解析
+        //    完整重写后对象编号和结构都可能改变，重新加载文档
+        if (inPlace && rewrite) {
+            auto reloaded = std::make_shared<PdfMemDocument>();
+            reloaded->Load(snapshot.fileName.toStdString());
+            for (int pageIndex : snapshot.extractedPages) {
+                std::vector<UPdfTextState> states;
+                UPdfExtractTextStates(reloaded->GetPages().GetPageAt(pageIndex), states);
+                snapshot.states.insert(pageIndex, states);
+            }
+            snapshot.reloaded = reloaded;
+        }
+        emit saveProgress(SAVE_PROGRESS_MAX);
+    }
+    catch (SaveCancelled&) {
+        // 追加的内容已截断，QSaveFile 析构时丢弃临时文件
+        qDebug() << "writeSnapshot() >> cancelled";
+    }
+    catch (PdfError& e) {
+        e.PrintErrorMsg();
+        snapshot.message = QString::fromStdString(std::string(e.ErrorMessage(e.GetCode())));
+    }
+}
+
+void EditModel::writeTextLayer(SaveSnapshot &snapshot)
+{
+    QSaveFile file(snapshot.fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        snapshot.message = file.errorString();
+        return;
+    }
+
+    // PdfStreamedDocument 每写完一页就把页面对象写入文件并释放，内存占用与页数无关
+    // 字体和文件尾在文档析构时写入，析构函数中不能抛出异常：
+    // 正常结束时先让设备只记录写入错误再析构，取消或出错时丢弃之后的写入
+    auto device = std::make_shared<QIODeviceOutputStream>(file);
+    std::unique_ptr<PdfStreamedDocument> document;
+    try {
+        document.reset(new PdfStreamedDocument(device));
+        FontResolver fonts(*document);
+        PdfPainter painter;
+
+        const int pageCount = snapshot.trimBoxes.size();
+        for (int pageIndex=0; pageIndex<pageCount; pageIndex++) {
+            if (m_cancelSave)
+                throw SaveCancelled();
+
+            // 未提取的页面临时提取，不保存在模型中
+            QVector<UPdfTextRun> runs;
+            auto it = snapshot.pages.constFind(pageIndex);
+            if (it != snapshot.pages.constEnd()) {
+                for (const auto& editRun : it.value())
+                    runs.append(editRun.run);
+            }
+            else {
+                QMutexLocker locker(&m_documentMutex);
+                try {
+                    UPdfExtractTextRuns(snapshot.document->GetPages().GetPageAt(pageIndex), runs);
+                }
+                catch (PdfError& e) {
+                    e.PrintErrorMsg();
+                }
+            }
+
+            const QRectF& trimBox = snapshot.trimBoxes[pageIndex];
+            auto& page = document->GetPages().CreatePage(Rect(trimBox.x(), trimBox.y(), trimBox.width(), trimBox.height()));
+            painter.SetCanvas(page);
+            for (const auto& run : runs) {
+                PdfFont* font = fonts.resolve(run.font);
+                if (font == nullptr)
+                    continue;
+                painter.TextState.SetFont(*font, run.font.pointSizeF());
+                painter.DrawText(run.text.toStdString(), run.pos.x(), run.pos.y());
+            }
+            painter.FinishDrawing();
+            emit saveProgress(95 * (pageIndex + 1) / pageCount);
+        }
+
+        device->deferErrors();
+        document.reset();
+        if (!device->errorString().isEmpty())
+            throw PdfError(PdfErrorCode::InvalidDeviceOperation, __FILE__, __LINE__,
+                           device->errorString().toStdString());
+        if (m_cancelSave)
+            throw SaveCancelled();
+        if (!file.commit())
+            snapshot.message = file.errorString();
+        else
+            snapshot.succeeded = true;
+        emit saveProgress(SAVE_PROGRESS_MAX);
+    }
+    catch (SaveCancelled&) {
+        qDebug() << "writeTextLayer() >> cancelled";
+    }
+    catch (PdfError& e) {
+        e.PrintErrorMsg();
+        snapshot.message = QString::fromStdString(std::string(e.ErrorMessage(e.GetCode())));
+    }
+
+    // 取消或出错时文档还没有结束，析构时写入的内容全部丢弃，QSaveFile 析构时丢弃临时文件
+    device->discard();
+    document.reset();
+}
+
+void EditModel::onSaveFinished(const std::shared_ptr<SaveSnapshot> &snapshot)
+{
+    // 保存期间切换了文档，结果不再适用
+    if (snapshot->document != m_document)
+        return;
+    m_saving = false;
+    m_savedBytes = snapshot->savedBytes;
+
+    // 导出不修改文档和模型
+    if (snapshot->textLayer) {
+        emit saveFinished(snapshot->succeeded, snapshot->message);
+        return;
+    }
+
+    // 只修改了副本，另存为、取消或失败时模型不变
+    // 保存到原文件后，同步运算对象位置、遮盖区域和叠加表单
+    if (snapshot->succeeded && snapshot->fileName == m_fileName) {
+        for (auto it = snapshot->pages.cbegin(); it != snapshot->pages.cend(); ++it) {
+            QVector<EditRun>& runs = m_pages[it.key()].runs;
+            for (int i=0; i<runs.size() && i<it.value().size(); i++) {
+                const UPdfTextRun& saved = it.value()[i].run;
+                runs[i].run.bounds = saved.bounds;
+                runs[i].run.operandOffset = saved.operandOffset;
+                runs[i].run.operandLength = saved.operandLength;
+            }
+        }
+        for (auto it = snapshot->overlays.cbegin(); it != snapshot->overlays.cend(); ++it) {
+            m_pages[it.key()].overlay = it.value();
+            m_pages[it.key()].overlaidRuns.unite(snapshot->overlaidRuns.value(it.key()));
+        }
+        if (!snapshot->reloaded) {
+            // 运算对象的位置已在保存时按写入的内容流更新
+            QMutexLocker locker(&m_documentMutex);
+            const PdfFilterList filters = { PdfFilterType::FlateDecode };
+            for (const auto& content : snapshot->contents) {
+                PdfObject* object = m_document->GetObjects().GetObject(content.first);
+                if (object == nullptr)
+                    continue;
+                object->GetDictionary().RemoveKey("DecodeParms");
+                const bufferview data(content.second.constData(), size_t(content.second.size()));
+                object->GetOrCreateStream().SetData(data, filters, true);
+            }
+            // 新的表单只在文件中，资源中记录它的编号，之后的保存按名称找到并重新生成
+            for (auto it = snapshot->resources.cbegin(); it != snapshot->resources.cend(); ++it)
+                m_document->GetPages().GetPageAt(it.key()).GetDictionary().AddKey("Resources", it.value());
+            m_nextObjectNumber = snapshot->nextObjectNumber;
+        }
+        markSaved(*snapshot);
+    }
+
+    if (snapshot->reloaded) {
+        m_document = snapshot->reloaded;
+        m_nextObjectNumber = 0;
+        for (int i=0; i<m_pages.size(); i++) {
+            if (!m_pages[i].extracted)
+                continue;
+            // 保存期间新提取的页面在这里补上
+            std::vector<UPdfTextState> states;
+            if (snapshot->states.contains(i))
+                states = snapshot->states.value(i);
+            else
+                UPdfExtractTextStates(m_document->GetPages().GetPageAt(i), states);
+            rebindPage(i, states);
+        }
+    }
+
+    emit saveFinished(snapshot->succeeded, snapshot->message);
+}
+
+void EditModel::extractPage(int pageIndex)
+{
+    Page& page = m_pages[pageIndex];
+    if (page.extracted || !m_document)
+        return;
+    page.extracted = true;
+
+    QMutexLocker locker(&m_documentMutex);
+    QVector<UPdfTextRun> runs;
+    try {
+        UPdfExtractTextRuns(m_document->GetPages().GetPageAt(pageIndex), runs);
+    }
+    catch (PdfError& e) {
+        // 解析失败的页面按没有文本处理
+        e.PrintErrorMsg();
+        runs.clear();
+    }
+
+    page.runs.reserve(runs.size());
+    for (const auto& run : runs) {
+        EditRun editRun;
+        editRun.run = run;
+        editRun.original = run;
+        page.runs.append(editRun);
+    }
+}
+
+void EditModel::markChanged(const EditRunIndex &index)
+{
+    editRun(index).version++;
+    updateDirty(index);
+    emit runChanged(index.first, index.second);
+}
+
+void EditModel::updateDirty(const EditRunIndex &index)
+{
+    EditRun& editRun = this->editRun(index);
+    editRun.dirty = editRun.run.text != editRun.original.text
+            || editRun.run.pos != editRun.original.pos
+            || editRun.run.font != editRun.original.font;
+    if (editRun.dirty)
+        m_dirtyRuns.insert(index);
+    else
+        m_dirtyRuns.remove(index);
+}
+
+void EditModel::markSaved(const SaveSnapshot &snapshot)
+{
+    // 保存期间用户可能继续修改，原文本取保存时的内容
+    for (const auto& index : snapshot.dirtyRuns) {
+        const UPdfTextRun& saved = snapshot.pages.value(index.first)[index.second].run;
+        EditRun& editRun = this->editRun(index);
+        editRun.original.text = saved.text;
+        editRun.original.pos = saved.pos;
+        editRun.original.font = saved.font;
+        updateDirty(index);
+    }
+    if (!isDirty())
+        m_undoStack->setClean();
+}
+
+void EditModel::rebindPage(int pageIndex, const std::vector<UPdfTextState> &states)
+{
+    // 与提取时相同：状态按顺序对应，运算对象解码后与原文本一致才能直接替换
+    QVector<EditRun>& runs = m_pages[pageIndex].runs;
+    for (int i=0; i<runs.size(); i++) {
+        UPdfTextRun& run = runs[i].run;
+        run.pdfFont = nullptr;
+        run.operandOffset = -1;
+        run.operandLength = 0;
+        if (size_t(i) >= states.size())
+            continue;
+        const UPdfTextState& state = states[size_t(i)];
+        if (state.operandLength > 0 && state.operandText == runs[i].original.text.toStdString()) {
+            run.pdfFont = state.font;
+            run.operandOffset = qint64(state.operandOffset);
+            run.operandLength = qint64(state.operandLength);
+        }
+    }
+    // 叠加绘制的文本在内容流中已被遮盖
+    for (int runIndex : m_pages[pageIndex].overlaidRuns) {
+        if (runIndex < runs.size())
+            runs[runIndex].run.operandOffset = -1;
+    }
+}
@@ -0,0 +1,74 @@
+#include "fontmetricscache.h"
+
+FontMetricsCache::Entry::Entry(const QFont& font)
+    : metrics(font)
+    , metricsF(font)
+{
+    for (int u = 0; u < int(advances.size()); u++) {
+        QChar ch(u);
+        // 控制字符（包括 C1 控制字符）的宽度依赖排版，字体缺字时 Qt 会回退到其他字体
+        if (u < 0x20 || (u >= 0x7F && u < 0xA0) || !metrics.inFont(ch)) {
+            advances[u] = -1;
+        }
+        else {
+            advances[u] = metricsF.horizontalAdvance(ch);
+        }
+    }
+}
+
+FontMetricsCache::FontMetricsCache()
+    : m_entries(MAX_ENTRIES)
+{
+
+}
+
+FontMetricsCache& FontMetricsCache::instance()
+{
+    static FontMetricsCache cache;
+    return cache;
+}
+
+const FontMetricsCache::Entry& FontMetricsCache::entry(const QFont& font)
+{
+    const QString key = font.key();
+    Entry* cached = m_entries.object(key);
+    if (cached != nullptr)
+        return *cached;
+    // 每个字体的开销计为 1，QCache 按最近使用的顺序淘汰
+    Entry* created = new Entry(font);
+    m_entries.insert(key, created);
+    return *created;
+}
+
+int FontMetricsCache::horizontalAdvance(const QFont& font, const QString& text)
+{
+    const Entry& e = entry(font);
+
+    // 查表求和：循环内没有分支，编译器可以向量化
+    // 注：查表不计字距调整（kerning），有字距调整的字体与 Qt 排版的结果会有差异
+    const ushort* data = reinterpret_cast<const ushort*>(text.constData());
+    const int length = text.length();
+    qreal sum = 0;
+    int fallback = 0;
+    for (int i = 0; i < length; i++) {
+        const ushort u = data[i];
+        const qreal advance = e.advances[u & 0xFF];
+        fallback |= (u >> 8) | (advance < 0);
+        sum += advance;
+    }
+
+    // 复杂文字交给 Qt 排版
+    if (fallback)
+        return qRound(e.metricsF.horizontalAdvance(text));
+    return qRound(sum);
+}
+
+int FontMetricsCache::height(const QFont& font)
+{
+    return entry(font).metrics.height();
+}
+
+void FontMetricsCache::clear()
+{
+    m_entries.clear();
+}
@@ -0,0 +1,79 @@
+#include "fontresolver.h"
+#include "tools.h"
+
+#include <QFileInfo>
+#include <QSettings>
+
+using namespace PoDoFo;
+
+// QSettings 中保存字体文件路径的分组
+static const char* FONT_PATHS_GROUP = "FontPaths";
+
+FontResolver::FontResolver(PdfDocument &document)
+    : m_document(document)
+{
+}
+
+QString FontResolver::cacheKey(const QFont &font)
+{
+    return QString("%1|%2|%3").arg(font.family()).arg(font.weight()).arg(int(font.style()));
+}
+
+PdfFont* FontResolver::resolve(const QFont &font)
+{
+    const QString key = cacheKey(font);
+    auto it = m_fonts.constFind(key);
+    if (it != m_fonts.constEnd())
+        return it.value();
+
+    PdfFont* pdfFont = loadCachedPath(key);
+    if (pdfFont == nullptr) {
+        // 获取字体
+        QString fontName;
+        QFont2PdfFont(font, fontName);
+
+        PdfFontSearchParams params;
+        params.AutoSelect = PdfFontAutoSelectBehavior::Standard14;
+        pdfFont = m_document.GetFonts().SearchFont(fontName.toStdString(), params, m_createParams);
+
+        if (pdfFont != nullptr)
+            storeCachedPath(key, *pdfFont);
+    }
+    m_fonts.insert(key, pdfFont);
+    return pdfFont;
+}
+
+PdfFont* FontResolver::loadCachedPath(const QString &key)
+{
+    QSettings settings;
+    settings.beginGroup(FONT_PATHS_GROUP);
+    const QStringList value = settings.value(key).toStringList();
+    if (value.size() != 2)
+        return nullptr;
+
+    // 字体文件已被删除或无法读取时，丢弃记录，重新查找
+    const QString& path = value[0];
+    if (QFileInfo::exists(path)) {
+        try {
+            return &m_document.GetFonts().GetOrCreateFont(path.toStdString(), value[1].toUInt(), m_createParams);
+        }
+        catch (PdfError& e) {
+            e.PrintErrorMsg();
+        }
+    }
+    settings.remove(key);
+    return nullptr;
+}
+
+void FontResolver::storeCachedPath(const QString &key, const PdfFont &font)
+{
+    // 标准 14 字体不对应字体文件，不需要记录
+    const std::string& path = font.GetMetrics().GetFilePath();
+    if (path.empty())
+        return;
+
+    QSettings settings;
+    settings.beginGroup(FONT_PATHS_GROUP);
+    settings.setValue(key, QStringList{ QString::fromStdString(path),
+                                        QString::number(font.GetMetrics().GetFaceIndex()) });
+}
@@ -0,0 +1,279 @@
+#include "imagedownsampler.h"
+#include "tools.h"
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QImageWriter>
+#include <QSizeF>
+#include <QThread>
+#include <QThreadPool>
+#include <QTransform>
+#include <QVector>
+
+#include <cmath>
+#include <cstring>
+
+using namespace PoDoFo;
+
+// 一张待处理的图片；数据在主线程读出，解码、缩小和编码在线程池中进行
+struct ImageJob {
+    PdfObject* object = nullptr;
+    int components = 0;         // 1：灰度；3：RGB
+    bool jpeg = false;          // data 为 JPEG 数据，否则为解码后的像素
+    QByteArray data;
+    int width = 0;
+    int height = 0;
+    int targetWidth = 0;
+    int targetHeight = 0;
+    qint64 originalSize = 0;    // 未解码的流数据长度
+    QByteArray encoded;
+};
+
+static bool TryGetInt(const PdfDictionary &dictionary, const char *key, int64_t &value)
+{
+    const PdfObject* object = dictionary.FindKey(key);
+    return object != nullptr && object->TryGetNumber(value);
+}
+
+// 颜色分量数，不支持的颜色空间返回 0
+static int ColorComponents(const PdfDictionary &dictionary)
+{
+    const PdfObject* colorSpace = dictionary.FindKey("ColorSpace");
+    if (colorSpace == nullptr)
+        return 0;
+    const PdfName* name = nullptr;
+    if (colorSpace->TryGetName(name)) {
+        if (name->GetString() == "DeviceGray")
+            return 1;
+        if (name->GetString() == "DeviceRGB")
+            return 3;
+        return 0;
+    }
+    // [/ICCBased <<... /N n>>]：分量数相同时颜色空间可以保留
+    const PdfArray* array = nullptr;
+    if (!colorSpace->TryGetArray(array) || array->GetSize() != 2
+            || !(*array)[0].TryGetName(name) || name->GetString() != "ICCBased")
+        return 0;
+    const PdfObject* profile = array->FindAt(1);
+    int64_t n = 0;
+    if (profile == nullptr || !profile->IsDictionary() || !TryGetInt(profile->GetDictionary(), "N", n)
+            || (n != 1 && n != 3))
+        return 0;
+    return int(n);
+}
+
+// 流的唯一过滤器，没有过滤器时为空，多个过滤器时返回 false
+static bool SingleFilter(const PdfDictionary &dictionary, std::string &filter)
+{
+    filter.clear();
+    const PdfObject* value = dictionary.FindKey("Filter");
+    if (value == nullptr)
+        return true;
+    const PdfName* name = nullptr;
+    const PdfArray* array = nullptr;
+    if (value->TryGetArray(array)) {
+        if (array->GetSize() == 0)
+            return true;
+        if (array->GetSize() != 1)
+            return false;
+        value = &(*array)[0];
+    }
+    if (!value->TryGetName(name))
+        return false;
+    filter = name->GetString();
+    return true;
+}
+
+// 各页内容中绘制的图片及其在页面上的最大尺寸（点），沿表单 XObject 跟踪当前变换矩阵
+static QHash<quint64, QSizeF> PlacedImages(PdfDocument &document)
+{
+    QHash<quint64, QSizeF> placed;
+    auto& pages = document.GetPages();
+    for (unsigned i=0; i<pages.GetCount(); i++) {
+        QTransform ctm;
+        QVector<QTransform> saved;
+        PdfContentStreamReader reader(pages.GetPageAt(i));
+        PdfContent content;
+        while (reader.TryReadNext(content)) {
+            switch (content.Type) {
+            case PdfContentType::Operator:
+                if (content.Operator == PdfOperator::q) {
+                    saved.append(ctm);
+                }
+                else if (content.Operator == PdfOperator::Q) {
+                    if (!saved.isEmpty())
+                        ctm = saved.takeLast();
+                }
+                else if (content.Operator == PdfOperator::cm && content.Stack.GetSize() >= 6) {
+                    // 栈顶（序号 0）为最后一个运算对象 f
+                    double m[6];
+                    bool ok = true;
+                    for (int k=0; k<6; k++)
+                        ok = ok && content.Stack[size_t(5 - k)].TryGetReal(m[k]);
+                    if (ok)
+                        ctm = QTransform(m[0], m[1], m[2], m[3], m[4], m[5]) * ctm;
+                }
+                break;
+            case PdfContentType::DoXObject:
+                if (content.XObject == nullptr)
+                    break;
+                if (content.XObject->GetType() == PdfXObjectType::Form) {
+                    // 表单的内容紧接着读出，以 EndXObjectForm 结束
+                    const Matrix matrix = content.XObject->GetMatrix();
+                    saved.append(ctm);
+                    ctm = QTransform(matrix[0], matrix[1], matrix[2], matrix[3], matrix[4], matrix[5]) * ctm;
+                }
+                else if (content.XObject->GetType() == PdfXObjectType::Image) {
+                    // 图片绘制在单位正方形中，两个方向的尺寸是矩阵两行的长度
+                    const QSizeF size(std::hypot(ctm.m11(), ctm.m12()), std::hypot(ctm.m21(), ctm.m22()));
+                    QSizeF& largest = placed[UPdfReferenceKey(content.XObject->GetObject().GetIndirectReference())];
+                    largest = largest.expandedTo(size);
+                }
+                break;
+            case PdfContentType::EndXObjectForm:
+                if (!saved.isEmpty())
+                    ctm = saved.takeLast();
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    return placed;
+}
+
+// 检查图片能否处理并计算目标尺寸，不需要缩小时返回 false
+static bool PrepareJob(PdfObject &object, const QSizeF &placed, int targetDpi, ImageJob &job)
+{
+    const PdfDictionary* dictionary = nullptr;
+    if (!object.HasStream() || !object.TryGetDictionary(dictionary))
+        return false;
+
+    const PdfObject* imageMask = dictionary->FindKey("ImageMask");
+    const PdfObject* mask = dictionary->FindKey("Mask");
+    int64_t width = 0, height = 0, bits = 0;
+    if ((imageMask != nullptr && imageMask->IsBool() && imageMask->GetBool())
+            || (mask != nullptr && mask->IsArray()) || dictionary->HasKey("Decode")
+            || !TryGetInt(*dictionary, "Width", width) || !TryGetInt(*dictionary, "Height", height)
+            || !TryGetInt(*dictionary, "BitsPerComponent", bits) || bits != 8 || width <= 0 || height <= 0)
+        return false;
+
+    job.components = ColorComponents(*dictionary);
+    std::string filter;
+    if (job.components == 0 || !SingleFilter(*dictionary, filter)
+            || !(filter.empty() || filter == "FlateDecode" || filter == "DCTDecode"))
+        return false;
+
+    // 两个方向分别计算，只缩小超过目标分辨率的方向
+    job.width = int(width);
+    job.height = int(height);
+    job.targetWidth = job.width;
+    job.targetHeight = job.height;
+    if (placed.width() > 0 && width * 72.0 / placed.width() > targetDpi)
+        job.targetWidth = qMax(1, int(std::ceil(placed.width() / 72.0 * targetDpi)));
+    if (placed.height() > 0 && height * 72.0 / placed.height() > targetDpi)
+        job.targetHeight = qMax(1, int(std::ceil(placed.height() / 72.0 * targetDpi)));
+    if (job.targetWidth == job.width && job.targetHeight == job.height)
+        return false;
+
+    job.object = &object;
+    job.jpeg = filter == "DCTDecode";
+    return true;
+}
+
+// 在线程池中执行：解码、缩小并编码为 JPEG，失败时 encoded 为空
+static void EncodeJob(ImageJob &job, int quality)
+{
+    QImage image;
+    if (job.jpeg) {
+        image = QImage::fromData(job.data, "JPEG");
+    }
+    else {
+        const int stride = job.width * job.components;
+        if (qint64(job.data.size()) < qint64(stride) * job.height)
+            return;
+        image = QImage(job.width, job.height, job.components == 3 ? QImage::Format_RGB888 : QImage::Format_Grayscale8);
+        for (int y=0; y<job.height; y++)
+            memcpy(image.scanLine(y), job.data.constData() + qint64(y) * stride, size_t(stride));
+    }
+    job.data.clear();
+    if (image.isNull())
+        return;
+
+    // 编码的分量数必须与颜色空间一致
+    image = image.scaled(job.targetWidth, job.targetHeight, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+            .convertToFormat(job.components == 3 ? QImage::Format_RGB888 : QImage::Format_Grayscale8);
+    QBuffer buffer(&job.encoded);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, "jpeg");
+    writer.setQuality(quality);
+    if (!writer.write(image))
+        job.encoded.clear();
+}
+
+ImageDownsampler::ImageDownsampler(PdfDocument &document)
+    : m_document(document), m_targetDpi(DEFAULT_TARGET_DPI),
+      m_jpegQuality(DEFAULT_JPEG_QUALITY), m_savedBytes(0)
+{
+
+}
+
+int ImageDownsampler::run()
+{
+    m_savedBytes = 0;
+    PdfIndirectObjectList& objects = m_document.GetObjects();
+    const QHash<quint64, QSizeF> placed = PlacedImages(m_document);
+
+    QVector<ImageJob> candidates;
+    for (auto it = placed.cbegin(); it != placed.cend(); ++it) {
+        PdfObject* object = objects.GetObject(PdfReference(uint32_t(it.key() >> 16), uint16_t(it.key() & 0xFFFF)));
+        ImageJob job;
+        if (object != nullptr && PrepareJob(*object, it.value(), m_targetDpi, job))
+            candidates.append(job);
+    }
+
+    // 解码后的扫描图片很大，分批处理，同时只保留一批的数据
+    const int batchSize = qMax(1, QThread::idealThreadCount()) * 2;
+    const PdfFilterList filters = { PdfFilterType::DCTDecode };
+    int count = 0;
+    for (int first=0; first<candidates.size(); first+=batchSize) {
+        const int last = qMin(first + batchSize, candidates.size());
+        for (int i=first; i<last; i++) {
+            ImageJob& job = candidates[i];
+            const charbuff raw = job.object->GetStream()->GetCopy(true);
+            job.originalSize = qint64(raw.size());
+            const charbuff data = job.jpeg ? raw : job.object->GetStream()->GetCopy();
+            job.data = QByteArray(data.data(), int(data.size()));
+        }
+
+        QThreadPool pool;
+        const int quality = m_jpegQuality;
+        for (int i=first; i<last; i++) {
+            ImageJob *job = &candidates[i];
+            pool.start([job, quality]() {
+                EncodeJob(*job, quality);
+            });
+        }
+        pool.waitForDone();
+
+        // 比原来的数据小才替换，尺寸和过滤器随之更新，颜色空间不变
+        for (int i=first; i<last; i++) {
+            ImageJob& job = candidates[i];
+            if (!job.encoded.isEmpty() && job.encoded.size() < job.originalSize) {
+                const bufferview data(job.encoded.constData(), size_t(job.encoded.size()));
+                job.object->GetOrCreateStream().SetData(data, filters, true);
+                PdfDictionary& dictionary = job.object->GetDictionary();
+                dictionary.AddKey("Width", PdfObject(int64_t(job.targetWidth)));
+                dictionary.AddKey("Height", PdfObject(int64_t(job.targetHeight)));
+                dictionary.AddKey("BitsPerComponent", PdfObject(int64_t(8)));
+                dictionary.RemoveKey("DecodeParms");
+                m_savedBytes += job.originalSize - job.encoded.size();
+                count++;
+            }
+            job.encoded.clear();
+        }
+    }
+    return count;
+}
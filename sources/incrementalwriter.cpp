@@ -0,0 +1,215 @@
+#include "incrementalwriter.h"
+#include "tools.h"
+
+#include <QIODevice>
+#include <QVector>
+
+#include <cstdio>
+#include <string>
+
+using namespace PoDoFo;
+
+// 在原文件末尾查找 startxref 的范围
+static const qint64 TailSize = 1024;
+// 复制原文件时每次读取的字节数
+static const qint64 CopyChunkSize = 1 << 20;
+
+IncrementalWriter::IncrementalWriter(const PdfDictionary &trailer, uint32_t size,
+                                     std::shared_ptr<const PdfEncrypt> encrypt)
+    : m_trailer(trailer), m_size(qMax<uint32_t>(size, 1)), m_encrypt(std::move(encrypt)),
+      m_compressionLevel(-1)
+{
+
+}
+
+PdfReference IncrementalWriter::createObject()
+{
+    return PdfReference(m_size++, 0);
+}
+
+void IncrementalWriter::setObject(const PdfReference &ref, const PdfObject &value)
+{
+    Entry& entry = m_objects[UPdfReferenceKey(ref)];
+    entry.ref = ref;
+    entry.value = value;
+    entry.data.clear();
+    entry.stream = false;
+    m_size = qMax(m_size, ref.ObjectNumber() + 1);
+}
+
+void IncrementalWriter::setStream(const PdfReference &ref, const PdfDictionary &dictionary, const QByteArray &data)
+{
+    Entry& entry = m_objects[UPdfReferenceKey(ref)];
+    entry.ref = ref;
+    entry.value = PdfObject(dictionary);
+    entry.data = data;
+    entry.stream = true;
+    m_size = qMax(m_size, ref.ObjectNumber() + 1);
+}
+
+quint64 IncrementalWriter::findLastXRef(QIODevice &source, bool &isStream)
+{
+    const qint64 length = source.size();
+    source.seek(qMax<qint64>(0, length - TailSize));
+    const QByteArray tail = source.read(TailSize);
+    const int keyword = tail.lastIndexOf("startxref");
+    bool ok = false;
+    const qint64 offset = keyword < 0 ? -1
+            : tail.mid(keyword + 9).simplified().split(' ').value(0).toLongLong(&ok);
+    if (!ok || offset < 0 || offset >= length)
+        throw PdfError(PdfErrorCode::InvalidXRef, __FILE__, __LINE__, "startxref not found");
+
+    // 交叉引用表以 xref 开头，交叉引用流是一个普通的间接对象
+    source.seek(offset);
+    isStream = !source.read(4).startsWith("xref");
+    return quint64(offset);
+}
+
+void IncrementalWriter::writeEntry(OutputStreamDevice &device, const Entry &entry)
+{
+    const PdfStatefulEncrypt encrypt = m_encrypt ? PdfStatefulEncrypt(*m_encrypt, entry.ref) : PdfStatefulEncrypt();
+    charbuff buffer;
+    device.Write(std::to_string(entry.ref.ObjectNumber()) + " " + std::to_string(entry.ref.GenerationNumber()) + " obj\n");
+    if (!entry.stream) {
+        entry.value.GetVariant().Write(device, PdfWriteFlags::None, encrypt, buffer);
+        device.Write("\nendobj\n");
+        return;
+    }
+
+    // 加密后的长度可能不同
+    PdfObject dictionary(entry.value);
+    charbuff data(entry.data.constData(), size_t(entry.data.size()));
+    if (encrypt.HasEncrypt()) {
+        charbuff encrypted;
+        encrypt.EncryptTo(encrypted, data);
+        data = std::move(encrypted);
+    }
+    dictionary.GetDictionary().AddKey("Length", PdfObject(int64_t(data.size())));
+    dictionary.GetVariant().Write(device, PdfWriteFlags::None, encrypt, buffer);
+    device.Write("\nstream\n");
+    device.Write(data.data(), data.size());
+    device.Write("\nendstream\nendobj\n");
+}
+
+void IncrementalWriter::write(QIODevice &source, OutputStreamDevice &device)
+{
+    // 1. 原样复制原文件
+    bool xrefStream = false;
+    const quint64 prevOffset = findLastXRef(source, xrefStream);
+    source.seek(0);
+    char last = '\n';
+    while (!source.atEnd()) {
+        const QByteArray chunk = source.read(CopyChunkSize);
+        if (chunk.isEmpty())
+            throw PdfError(PdfErrorCode::InvalidDeviceOperation, __FILE__, __LINE__,
+                           source.errorString().toStdString());
+        device.Write(chunk.constData(), size_t(chunk.size()));
+        last = chunk.at(chunk.size() - 1);
+    }
+    if (last != '\n' && last != '\r')
+        device.Write("\n");
+
+    writeUpdate(device, prevOffset, xrefStream);
+}
+
+void IncrementalWriter::append(QIODevice &file, OutputStreamDevice &device)
+{
+    bool xrefStream = false;
+    const quint64 prevOffset = findLastXRef(file, xrefStream);
+    const qint64 length = file.size();
+    file.seek(length - 1);
+    const QByteArray last = file.read(1);
+    file.seek(length);
+    if (last != "\n" && last != "\r")
+        device.Write("\n");
+
+    writeUpdate(device, prevOffset, xrefStream);
+}
+
+void IncrementalWriter::writeUpdate(OutputStreamDevice &device, quint64 prevOffset, bool xrefStream)
+{
+    // 2. 修改过的对象和新对象，编号从小到大
+    //    交叉引用流本身也占一个编号，在写入对象之前分配
+    const PdfReference xrefRef = xrefStream ? createObject() : PdfReference();
+    struct Offset {
+        PdfReference ref;
+        quint64 offset;
+    };
+    QVector<Offset> offsets;
+    offsets.reserve(m_objects.size() + 1);
+    for (const auto& entry : m_objects) {
+        offsets.append({ entry.ref, quint64(device.GetPosition()) });
+        writeEntry(device, entry);
+    }
+
+    // 新的文件尾：沿用原来的 /Root、/Info、/ID 和 /Encrypt
+    PdfDictionary trailer;
+    trailer.AddKey("Size", PdfObject(int64_t(m_size)));
+    trailer.AddKey("Prev", PdfObject(int64_t(prevOffset)));
+    for (const char* key : { "Root", "Info", "ID", "Encrypt" }) {
+        const PdfObject* value = m_trailer.GetKey(key);
+        if (value != nullptr)
+            trailer.AddKey(key, *value);
+    }
+
+    // 3. 交叉引用：编号连续的对象组成一个小节
+    const quint64 xrefOffset = device.GetPosition();
+    if (xrefRef.IsIndirect())
+        offsets.append({ xrefRef, xrefOffset });
+    QVector<QPair<int, int>> sections;      // (起始下标, 个数)
+    for (int i=0; i<offsets.size(); i++) {
+        if (i > 0 && offsets[i].ref.ObjectNumber() == offsets[i-1].ref.ObjectNumber() + 1)
+            sections.last().second++;
+        else
+            sections.append(qMakePair(i, 1));
+    }
+
+    if (!xrefStream) {
+        device.Write("xref\n");
+        char line[32];
+        for (const auto& section : sections) {
+            device.Write(std::to_string(offsets[section.first].ref.ObjectNumber()) + " "
+                         + std::to_string(section.second) + "\n");
+            for (int i=section.first; i<section.first+section.second; i++) {
+                // 每一项固定 20 字节
+                std::snprintf(line, sizeof(line), "%010llu %05u n\r\n",
+                              static_cast<unsigned long long>(offsets[i].offset),
+                              unsigned(offsets[i].ref.GenerationNumber()));
+                device.Write(line);
+            }
+        }
+        device.Write("trailer\n" + PdfObject(trailer).GetVariant().ToString() + "\n");
+    }
+    else {
+        // 交叉引用流不加密；第二个字段的宽度按最大的偏移量取最小值
+        int width = 1;
+        while (width < 8 && (xrefOffset >> (8 * width)) != 0)
+            width++;
+        QByteArray table;
+        PdfArray index;
+        for (const auto& section : sections) {
+            index.Add(PdfObject(int64_t(offsets[section.first].ref.ObjectNumber())));
+            index.Add(PdfObject(int64_t(section.second)));
+            for (int i=section.first; i<section.first+section.second; i++) {
+                table.append(char(1));
+                for (int k=width-1; k>=0; k--)
+                    table.append(char((offsets[i].offset >> (8 * k)) & 0xFF));
+                table.append(char(offsets[i].ref.GenerationNumber() >> 8));
+                table.append(char(offsets[i].ref.GenerationNumber() & 0xFF));
+            }
+        }
+        PdfArray widths;
+        widths.Add(PdfObject(int64_t(1)));
+        widths.Add(PdfObject(int64_t(width)));
+        widths.Add(PdfObject(int64_t(2)));
+        trailer.AddKey("Type", PdfName("XRef"));
+        trailer.AddKey("Index", index);
+        trailer.AddKey("W", widths);
+        trailer.AddKey("Filter", PdfName("FlateDecode"));
+        const QByteArray xref = UPdfSerializeStream(xrefRef.ObjectNumber(), trailer,
+                                                    UPdfDeflate(table, m_compressionLevel));
+        device.Write(xref.constData(), size_t(xref.size()));
+    }
+    device.Write("startxref\n" + std::to_string(xrefOffset) + "\n%%EOF\n");
+    device.Flush();
+}
@@ -0,0 +1,457 @@
+#include "linearizedwriter.h"
+#include "tools.h"
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+using namespace PoDoFo;
+
+// 按位写入提示表，每一项写完后按字节对齐
+class BitWriter
+{
+public:
+    void write(quint32 value, int bits)
+    {
+        for (int i=bits-1; i>=0; i--) {
+            m_byte = quint8((m_byte << 1) | ((value >> i) & 1));
+            if (++m_count == 8) {
+                m_data.append(char(m_byte));
+                m_byte = 0;
+                m_count = 0;
+            }
+        }
+    }
+    void align()
+    {
+        if (m_count > 0)
+            write(0, 8 - m_count);
+    }
+    const QByteArray& data()
+    {
+        align();
+        return m_data;
+    }
+
+private:
+    QByteArray m_data;
+    quint8 m_byte = 0;
+    int m_count = 0;
+};
+
+static int BitsNeeded(quint32 value)
+{
+    int bits = 0;
+    while (value != 0) {
+        bits++;
+        value >>= 1;
+    }
+    return bits;
+}
+
+// 写入线性化字典和第一页交叉引用表时还不知道最终的偏移量，数值固定写成 10 位，长度不变
+static std::string Padded(quint64 value)
+{
+    const std::string text = std::to_string(value);
+    return std::string(text.size() < 10 ? 10 - text.size() : 0, '0') + text;
+}
+
+// 交叉引用表的一项，固定 20 字节
+static std::string XRefEntry(quint64 offset, int generation, char type)
+{
+    char entry[21];
+    std::snprintf(entry, sizeof(entry), "%010llu %05d %c\r\n", static_cast<unsigned long long>(offset), generation, type);
+    return entry;
+}
+
+static qint64 TotalSize(const QVector<QByteArray> &data)
+{
+    qint64 size = 0;
+    for (const auto& item : data)
+        size += item.size();
+    return size;
+}
+
+// 从 root 出发按广度优先的顺序找出引用的对象（不包括 root），不经过 stops 中的对象
+static QVector<PdfObject*> Reachable(PdfIndirectObjectList &objects, const PdfObject &root, const QSet<quint64> &stops)
+{
+    QVector<PdfObject*> order;
+    QSet<quint64> visited;
+    if (root.IsIndirect())
+        visited.insert(UPdfReferenceKey(root.GetIndirectReference()));
+    QVector<PdfReference> pending;
+    UPdfCollectReferences(root, pending);
+    for (int i=0; i<pending.size(); i++) {
+        const quint64 key = UPdfReferenceKey(pending[i]);
+        if (visited.contains(key) || stops.contains(key))
+            continue;
+        visited.insert(key);
+        PdfObject* object = objects.GetObject(pending[i]);
+        if (object == nullptr)
+            continue;
+        order.append(object);
+        UPdfCollectReferences(*object, pending);
+    }
+    return order;
+}
+
+LinearizedWriter::LinearizedWriter(PdfDocument &document)
+    : m_document(document), m_compressionLevel(-1), m_deterministicId(false)
+{
+
+}
+
+void LinearizedWriter::write(OutputStreamDevice &device)
+{
+    if (m_document.IsEncrypted())
+        throw PdfError(PdfErrorCode::NotImplemented, __FILE__, __LINE__,
+                       "Linearized save does not support encrypted documents");
+    auto& pages = m_document.GetPages();
+    const int pageCount = int(pages.GetCount());
+    if (pageCount == 0)
+        throw PdfError(PdfErrorCode::PageNotFound, __FILE__, __LINE__,
+                       "Linearized save requires at least one page");
+
+    PdfIndirectObjectList& objects = m_document.GetObjects();
+    const PdfObject& trailer = m_document.GetTrailer().GetObject();
+    PdfObject& catalog = m_document.GetCatalog().GetObject();
+    auto key = [](const PdfObject *object) {
+        return UPdfReferenceKey(object->GetIndirectReference());
+    };
+
+    // 1. 找出每页用到的对象：遍历时不经过目录、其他页面和页面树节点（/Parent、/P、链接的目标页）
+    QSet<quint64> stops = { key(&catalog) };
+    QVector<PdfObject*> pageObjects;
+    for (int i=0; i<pageCount; i++) {
+        PdfObject* page = &pages.GetPageAt(unsigned(i)).GetObject();
+        pageObjects.append(page);
+        stops.insert(key(page));
+    }
+    for (PdfObject* object : objects) {
+        const PdfDictionary* dictionary = nullptr;
+        const PdfName* type = nullptr;
+        if (!object->TryGetDictionary(dictionary))
+            continue;
+        const PdfObject* value = dictionary->GetKey("Type");
+        if (value != nullptr && value->TryGetName(type) && type->GetString() == "Pages")
+            stops.insert(key(object));
+    }
+
+    QVector<QVector<PdfObject*>> pageClosures(pageCount);
+    QHash<quint64, int> users;     // 用到对象的页数
+    for (int i=0; i<pageCount; i++) {
+        pageClosures[i] = { pageObjects[i] };
+        pageClosures[i] += Reachable(objects, *pageObjects[i], stops);
+        for (PdfObject* object : pageClosures[i])
+            users[key(object)]++;
+    }
+
+    // 2. 按线性化文件的各部分排列对象，页面对象在每页的最前面
+    QSet<quint64> placed;
+    auto place = [&](QVector<PdfObject*> &part, PdfObject *object) {
+        if (placed.contains(key(object)))
+            return;
+        placed.insert(key(object));
+        part.append(object);
+    };
+
+    // 第一页：第一页用到的全部对象，包括与其他页共用的
+    QVector<PdfObject*> firstPage;
+    for (PdfObject* object : pageClosures[0])
+        place(firstPage, object);
+
+    // 文档级对象：目录以及打开文档时需要的、不属于任何页面的对象
+    QVector<PdfObject*> documentPart;
+    place(documentPart, &catalog);
+    for (const char* name : { "ViewerPreferences", "OpenAction", "AcroForm" }) {
+        PdfReference ref;
+        const PdfObject* value = catalog.GetDictionary().GetKey(name);
+        if (value == nullptr || !value->TryGetReference(ref))
+            continue;
+        PdfObject* object = objects.GetObject(ref);
+        if (object == nullptr || stops.contains(key(object)))
+            continue;
+        QVector<PdfObject*> closure = { object };
+        closure += Reachable(objects, *object, stops);
+        for (PdfObject* item : closure) {
+            if (!users.contains(key(item)))
+                place(documentPart, item);
+        }
+    }
+
+    // 其余页面：页面对象和只有这一页用到的对象
+    QVector<PdfObject*> otherPages;
+    QVector<int> pageStarts(pageCount + 1, 0);
+    for (int i=1; i<pageCount; i++) {
+        pageStarts[i] = otherPages.size();
+        for (PdfObject* object : pageClosures[i]) {
+            if (users.value(key(object)) == 1)
+                place(otherPages, object);
+        }
+    }
+    pageStarts[pageCount] = otherPages.size();
+
+    // 共享对象：多页共用、第一页没有用到的对象
+    QVector<PdfObject*> sharedPart;
+    for (int i=1; i<pageCount; i++) {
+        for (PdfObject* object : pageClosures[i]) {
+            if (users.value(key(object)) > 1)
+                place(sharedPart, object);
+        }
+    }
+
+    // 其他对象：页面树、大纲、文档信息等
+    QVector<PdfObject*> otherPart;
+    for (PdfObject* object : Reachable(objects, trailer, QSet<quint64>()))
+        place(otherPart, object);
+
+    // 3. 编号：主交叉引用表中的对象（其余页面、共享对象、其他对象）在前，
+    //    第一页交叉引用表中的对象（线性化字典、文档级对象、提示流、第一页）在后，都按在文件中的顺序
+    QHash<quint64, PdfReference> numbers;
+    uint32_t number = 0;
+    for (const QVector<PdfObject*>* part : { &otherPages, &sharedPart, &otherPart }) {
+        for (PdfObject* object : *part)
+            numbers.insert(key(object), PdfReference(++number, 0));
+    }
+    const uint32_t mainCount = number;
+    const uint32_t linearizationNumber = ++number;
+    for (PdfObject* object : documentPart)
+        numbers.insert(key(object), PdfReference(++number, 0));
+    const uint32_t hintNumber = ++number;
+    for (PdfObject* object : firstPage)
+        numbers.insert(key(object), PdfReference(++number, 0));
+    const uint32_t totalCount = number;
+
+    auto serialize = [&](const QVector<PdfObject*> &part) {
+        QVector<QByteArray> data;
+        data.reserve(part.size());
+        for (PdfObject* object : part)
+            data.append(UPdfSerializeObject(*object, numbers.value(key(object)).ObjectNumber(), numbers, m_compressionLevel));
+        return data;
+    };
+    const QVector<QByteArray> documentData = serialize(documentPart);
+    const QVector<QByteArray> firstPageData = serialize(firstPage);
+    const QVector<QByteArray> otherPagesData = serialize(otherPages);
+    const QVector<QByteArray> sharedData = serialize(sharedPart);
+    const QVector<QByteArray> otherData = serialize(otherPart);
+
+    // 4. 第一页的文件尾：/Prev 指向主交叉引用表
+    PdfDictionary trailerDictionary;
+    trailerDictionary.AddKey("Size", PdfObject(int64_t(totalCount) + 1));
+    for (const char* name : { "Root", "Info", "ID" }) {
+        const PdfObject* value = trailer.GetDictionary().GetKey(name);
+        if (value == nullptr)
+            continue;
+        PdfObject copy(*value);
+        UPdfRewriteReferences(copy, numbers);
+        trailerDictionary.AddKey(name, copy);
+    }
+    if (m_deterministicId) {
+        // 文件标识符取全部对象内容的摘要
+        QCryptographicHash md5(QCryptographicHash::Md5);
+        for (const QVector<QByteArray>* part : { &documentData, &firstPageData, &otherPagesData, &sharedData, &otherData }) {
+            for (const auto& data : *part)
+                md5.addData(data);
+        }
+        const QByteArray digest = md5.result();
+        PdfArray id;
+        id.Add(PdfString(charbuff(digest.constData(), size_t(digest.size())), true));
+        id.Add(PdfString(charbuff(digest.constData(), size_t(digest.size())), true));
+        trailerDictionary.AddKey("ID", id);
+    }
+    const std::string trailerText = PdfObject(trailerDictionary).ToString();
+
+    const int version = int(m_document.GetMetadata().GetPdfVersion());
+    const std::string header = "%PDF-" + std::to_string(version / 10) + "." + std::to_string(version % 10)
+            + "\n%\xE2\xE3\xCF\xD3\n";
+    auto linearizationDictionary = [&](quint64 fileLength, quint64 hintOffset, quint64 hintLength,
+                                       quint64 endOfFirstPage, quint64 mainXRefEntry) {
+        return std::to_string(linearizationNumber) + " 0 obj\n<</Linearized 1/L " + Padded(fileLength)
+                + "/H[" + Padded(hintOffset) + " " + Padded(hintLength) + "]/O "
+                + std::to_string(numbers.value(key(pageObjects[0])).ObjectNumber())
+                + "/E " + Padded(endOfFirstPage) + "/N " + std::to_string(pageCount)
+                + "/T " + Padded(mainXRefEntry) + ">>\nendobj\n";
+    };
+    auto firstXRef = [&](const QVector<quint64> &offsets, quint64 mainXRefOffset) {
+        std::string text = "xref\n" + std::to_string(mainCount + 1) + " " + std::to_string(totalCount - mainCount) + "\n";
+        for (quint64 offset : offsets)
+            text += XRefEntry(offset, 0, 'n');
+        return text + "trailer\n<</Prev " + Padded(mainXRefOffset) + trailerText.substr(2)
+                + "\nstartxref\n0\n%%EOF\n";
+    };
+
+    // 5. 先按没有提示流的排列计算各对象的位置，提示表中的偏移量都不计提示流本身
+    const quint64 firstXRefOffset = header.size() + linearizationDictionary(0, 0, 0, 0, 0).size();
+    const quint64 documentOffset = firstXRefOffset
+            + firstXRef(QVector<quint64>(int(totalCount - mainCount), 0), 0).size();
+    const quint64 hintOffset = documentOffset + TotalSize(documentData);
+
+    auto offsetsOf = [](const QVector<QByteArray> &data, quint64 start) {
+        QVector<quint64> offsets;
+        offsets.reserve(data.size());
+        for (const auto& item : data) {
+            offsets.append(start);
+            start += item.size();
+        }
+        return offsets;
+    };
+    QVector<quint64> firstPageOffsets = offsetsOf(firstPageData, hintOffset);
+    QVector<quint64> otherPagesOffsets = offsetsOf(otherPagesData, hintOffset + TotalSize(firstPageData));
+    QVector<quint64> sharedOffsets = offsetsOf(sharedData, hintOffset + TotalSize(firstPageData) + TotalSize(otherPagesData));
+    QVector<quint64> otherOffsets = offsetsOf(otherData, hintOffset + TotalSize(firstPageData) + TotalSize(otherPagesData)
+                                              + TotalSize(sharedData));
+
+    // 页面偏移提示表：每页的对象数和长度；内容流的位置按整页处理（偏移 0，长度为页面长度）
+    QVector<quint32> pageObjectCounts(pageCount), pageLengths(pageCount);
+    pageObjectCounts[0] = quint32(firstPage.size());
+    pageLengths[0] = quint32(TotalSize(firstPageData));
+    for (int i=1; i<pageCount; i++) {
+        pageObjectCounts[i] = quint32(pageStarts[i+1] - pageStarts[i]);
+        pageLengths[i] = 0;
+        for (int j=pageStarts[i]; j<pageStarts[i+1]; j++)
+            pageLengths[i] += quint32(otherPagesData[j].size());
+    }
+
+    // 共享对象提示表：每个对象一组，先是第一页中与其他页共用的对象，再是共享对象部分
+    QVector<quint32> groupLengths;
+    QHash<quint64, int> groupIds;
+    for (int j=0; j<firstPage.size(); j++) {
+        if (users.value(key(firstPage[j])) > 1) {
+            groupIds.insert(key(firstPage[j]), groupLengths.size());
+            groupLengths.append(quint32(firstPageData[j].size()));
+        }
+    }
+    const int firstPageGroups = groupLengths.size();
+    for (int j=0; j<sharedPart.size(); j++) {
+        groupIds.insert(key(sharedPart[j]), groupLengths.size());
+        groupLengths.append(quint32(sharedData[j].size()));
+    }
+
+    // 第一页的共享对象都在第一页部分中，不需要引用
+    QVector<QVector<quint32>> pageGroups(pageCount);
+    for (int i=1; i<pageCount; i++) {
+        for (PdfObject* object : pageClosures[i]) {
+            auto it = groupIds.constFind(key(object));
+            if (it != groupIds.constEnd())
+                pageGroups[i].append(quint32(it.value()));
+        }
+    }
+
+    const quint32 minObjects = *std::min_element(pageObjectCounts.cbegin(), pageObjectCounts.cend());
+    const quint32 maxObjects = *std::max_element(pageObjectCounts.cbegin(), pageObjectCounts.cend());
+    const quint32 minLength = *std::min_element(pageLengths.cbegin(), pageLengths.cend());
+    const quint32 maxLength = *std::max_element(pageLengths.cbegin(), pageLengths.cend());
+    quint32 maxShared = 0;
+    for (const auto& groups : pageGroups)
+        maxShared = std::max(maxShared, quint32(groups.size()));
+    const int objectBits = BitsNeeded(maxObjects - minObjects);
+    const int lengthBits = BitsNeeded(maxLength - minLength);
+    const int sharedBits = BitsNeeded(maxShared);
+    const int groupIdBits = BitsNeeded(groupLengths.isEmpty() ? 0 : quint32(groupLengths.size() - 1));
+
+    BitWriter pageTable;
+    pageTable.write(minObjects, 32);
+    pageTable.write(quint32(firstPageOffsets[0]), 32);
+    pageTable.write(quint32(objectBits), 16);
+    pageTable.write(minLength, 32);
+    pageTable.write(quint32(lengthBits), 16);
+    pageTable.write(0, 32);             // 内容流相对页面的最小偏移
+    pageTable.write(0, 16);
+    pageTable.write(minLength, 32);     // 内容流的最小长度
+    pageTable.write(quint32(lengthBits), 16);
+    pageTable.write(quint32(sharedBits), 16);
+    pageTable.write(quint32(groupIdBits), 16);
+    pageTable.write(0, 16);             // 共享对象在内容流中位置的分子位数
+    pageTable.write(1, 16);             // 分母
+    for (int i=0; i<pageCount; i++)
+        pageTable.write(pageObjectCounts[i] - minObjects, objectBits);
+    pageTable.align();
+    for (int i=0; i<pageCount; i++)
+        pageTable.write(pageLengths[i] - minLength, lengthBits);
+    pageTable.align();
+    for (int i=0; i<pageCount; i++)
+        pageTable.write(quint32(pageGroups[i].size()), sharedBits);
+    pageTable.align();
+    for (int i=0; i<pageCount; i++) {
+        for (quint32 group : pageGroups[i])
+            pageTable.write(group, groupIdBits);
+    }
+    pageTable.align();
+    // 分子为 0 位，内容流偏移为 0 位，都不占空间
+    for (int i=0; i<pageCount; i++)
+        pageTable.write(pageLengths[i] - minLength, lengthBits);
+
+    quint32 minGroupLength = 0, maxGroupLength = 0;
+    if (!groupLengths.isEmpty()) {
+        minGroupLength = *std::min_element(groupLengths.cbegin(), groupLengths.cend());
+        maxGroupLength = *std::max_element(groupLengths.cbegin(), groupLengths.cend());
+    }
+    const int groupLengthBits = BitsNeeded(maxGroupLength - minGroupLength);
+
+    BitWriter sharedTable;
+    sharedTable.write(sharedPart.isEmpty() ? 0 : numbers.value(key(sharedPart[0])).ObjectNumber(), 32);
+    sharedTable.write(sharedPart.isEmpty() ? 0 : quint32(sharedOffsets[0]), 32);
+    sharedTable.write(quint32(firstPageGroups), 32);
+    sharedTable.write(quint32(groupLengths.size()), 32);
+    sharedTable.write(0, 16);           // 每组只有一个对象
+    sharedTable.write(minGroupLength, 32);
+    sharedTable.write(quint32(groupLengthBits), 16);
+    for (quint32 length : groupLengths)
+        sharedTable.write(length - minGroupLength, groupLengthBits);
+    sharedTable.align();
+    for (int i=0; i<groupLengths.size(); i++)
+        sharedTable.write(0, 1);        // 没有 MD5 签名
+
+    QByteArray hintData = pageTable.data();
+    PdfDictionary hintDictionary;
+    hintDictionary.AddKey("S", PdfObject(int64_t(hintData.size())));
+    hintDictionary.AddKey("Filter", PdfName("FlateDecode"));
+    hintData += sharedTable.data();
+    const QByteArray hintObject = UPdfSerializeStream(hintNumber, hintDictionary, UPdfDeflate(hintData, m_compressionLevel));
+
+    // 6. 插入提示流后的实际位置
+    const quint64 hintLength = quint64(hintObject.size());
+    for (QVector<quint64>* offsets : { &firstPageOffsets, &otherPagesOffsets, &sharedOffsets, &otherOffsets }) {
+        for (quint64& offset : *offsets)
+            offset += hintLength;
+    }
+    const quint64 endOfFirstPage = hintOffset + hintLength + TotalSize(firstPageData);
+    const quint64 mainXRefOffset = endOfFirstPage + TotalSize(otherPagesData) + TotalSize(sharedData) + TotalSize(otherData);
+
+    std::string mainXRef = "xref\n0 " + std::to_string(mainCount + 1);
+    // /T 为主交叉引用表第一项之前的空白字符的位置
+    const quint64 mainXRefEntry = mainXRefOffset + mainXRef.size();
+    mainXRef += "\n" + XRefEntry(0, 65535, 'f');
+    for (const QVector<quint64>* offsets : { &otherPagesOffsets, &sharedOffsets, &otherOffsets }) {
+        for (quint64 offset : *offsets)
+            mainXRef += XRefEntry(offset, 0, 'n');
+    }
+    mainXRef += "trailer\n<</Size " + std::to_string(mainCount + 1) + ">>\nstartxref\n"
+            + std::to_string(firstXRefOffset) + "\n%%EOF\n";
+    const quint64 fileLength = mainXRefOffset + mainXRef.size();
+
+    QVector<quint64> firstOffsets = { quint64(header.size()) };
+    firstOffsets += offsetsOf(documentData, documentOffset);
+    firstOffsets.append(hintOffset);
+    firstOffsets += firstPageOffsets;
+
+    // 7. 写入
+    device.Write(header);
+    device.Write(linearizationDictionary(fileLength, hintOffset, hintLength, endOfFirstPage, mainXRefEntry));
+    device.Write(firstXRef(firstOffsets, mainXRefOffset));
+    for (const auto& data : documentData)
+        device.Write(data.constData(), size_t(data.size()));
+    device.Write(hintObject.constData(), size_t(hintObject.size()));
+    for (const QVector<QByteArray>* part : { &firstPageData, &otherPagesData, &sharedData, &otherData }) {
+        for (const auto& data : *part)
+            device.Write(data.constData(), size_t(data.size()));
+    }
+    device.Write(mainXRef);
+    device.Flush();
+}
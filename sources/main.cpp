@@ -41,6 +41,9 @@
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    // QSettings 使用的名称
+    QCoreApplication::setOrganizationName("UntitledPDF");
+    QCoreApplication::setApplicationName("UntitledPDF");
     MainWindow w;
     QStringList args = a.arguments();
     w.show();
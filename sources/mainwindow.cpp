@@ -39,6 +39,14 @@
 
 #include "pageselector.h"
 #include "zoomselector.h"
+#include "pagetilecache.h"
+#include "pageimagecache.h"
+#include "cachedpdfview.h"
+#include "thumbnailmodel.h"
+#include "editmodel.h"
+#include "editjournal.h"
+#include "imagedownsampler.h"
+#include "pdfeditview.h"
 #include "tools.h"
 
 #include <QFileDialog>
@@ -56,8 +64,17 @@
 #include <QTextCharFormat>
 #include <QFont>
 #include <QLayout>
+#include <QScrollBar>
+#include <QTimer>
+#include <QUndoStack>
 
 #include <QDir>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QInputDialog>
+#include <QProgressDialog>
+#include <QSettings>
+#include <QStatusBar>
 #include <QDebug>
 
 #include <podofo/podofo.h>
@@ -74,6 +91,11 @@ MainWindow::MainWindow(QWidget *parent)
     , m_zoomSelector(new ZoomSelector(this))
     , m_pageSelector(new PageSelector(this))
     , m_document(new QPdfDocument(this))
+    , m_tileCache(new PageTileCache(this))
+    , m_pageCache(new PageImageCache(this))
+    , m_thumbnailModel(new ThumbnailModel(this))
+    , m_editModel(new EditModel(this))
+    , m_editJournal(new EditJournal(m_editModel, this))
 {
     ui->setupUi(this);
 
@@ -82,7 +104,11 @@ MainWindow::MainWindow(QWidget *parent)
     ui->mainToolBar->insertWidget(ui->actionZoom_In, m_zoomSelector);
 
     connect(m_zoomSelector, &ZoomSelector::zoomModeChanged, ui->pdfView, &QPdfView::setZoomMode);
-    connect(m_zoomSelector, &ZoomSelector::zoomFactorChanged, ui->pdfView, &QPdfView::setZoomFactor);
+    // 连续的缩放由 pdfView 合并，只按最终的缩放渲染
+    connect(m_zoomSelector, &ZoomSelector::zoomFactorChanged, ui->pdfView, &CachedPdfView::requestZoomFactor);
+    // 编辑模式与阅读模式使用相同的缩放
+    connect(m_zoomSelector, &ZoomSelector::zoomModeChanged, ui->pdfEditView, &PdfEditView::setZoomMode);
+    connect(ui->pdfView, &QPdfView::zoomFactorChanged, ui->pdfEditView, &PdfEditView::setZoomFactor);
     m_zoomSelector->reset();
 
     // pageSelector
@@ -99,26 +125,74 @@ MainWindow::MainWindow(QWidget *parent)
     // Click bookmark -> Jump to page
     connect(ui->bookmarkView, SIGNAL(activated(QModelIndex)), this, SLOT(bookmarkSelected(QModelIndex)));
 
-    // tabWidget
-    ui->tabWidget->setTabEnabled(1, false); // disable 'Pages' tab for now
+    // tabWidget: Pages 标签页显示缩略图，点击跳转到对应页面
+    m_thumbnailModel->setDocument(m_document);
+    ui->thumbnailView->setModel(m_thumbnailModel);
+    connect(ui->thumbnailView, &QListView::clicked, this, [this](const QModelIndex &index){
+        ui->pdfView->pageNavigation()->setCurrentPage(index.row());
+    });
+    connect(ui->pdfView->pageNavigation(), &QPdfPageNavigation::currentPageChanged, this, [this](int page){
+        const QModelIndex index = m_thumbnailModel->index(page);
+        if (index.isValid() && ui->thumbnailView->currentIndex() != index) {
+            ui->thumbnailView->setCurrentIndex(index);
+            ui->thumbnailView->scrollTo(index);
+        }
+    });
 
-    // pdfView
+    // pdfView: 页面图片来自 m_pageCache
     ui->pdfView->setDocument(m_document);
+    m_pageCache->setDocument(m_document);
+    ui->pdfView->setPageCache(m_pageCache);
     connect(ui->pdfView, &QPdfView::zoomFactorChanged, m_zoomSelector, &ZoomSelector::setZoomFactor);
+
+    // pdfEditView: 编辑模式的连续多页视图，页面背景来自 m_tileCache
+    m_tileCache->setDocument(m_document);
+    ui->pdfEditView->setTileCache(m_tileCache);
+    ui->pdfEditView->setModel(m_editModel);
+
+    // 页面缓存的上限，保存时的压缩级别和保存方式
+    QSettings settings;
+    m_pageCache->setBudget(settings.value("View/PageCacheBudget", PageImageCache::DEFAULT_BUDGET).toInt());
+    m_editModel->setCompressionLevel(settings.value("Save/CompressionLevel", EditModel::DEFAULT_COMPRESSION_LEVEL).toInt());
+    m_editModel->setCompactSave(settings.value("Save/Compact", false).toBool());
+    ui->actionCompact_Save->setChecked(m_editModel->compactSave());
+    m_editModel->setOptimizeSave(settings.value("Save/Optimize", false).toBool());
+    ui->actionOptimize_on_Save->setChecked(m_editModel->optimizeSave());
+    m_editModel->setReproducibleSave(settings.value("Save/Reproducible", false).toBool());
+    ui->actionReproducible_Save->setChecked(m_editModel->reproducibleSave());
+    m_editModel->setLinearizeSave(settings.value("Save/Linearize", false).toBool());
+    ui->actionFast_Web_View->setChecked(m_editModel->linearizeSave());
+    m_editModel->setDownsampleImages(settings.value("Save/Downsample", false).toBool());
+    ui->actionDownsample_Images->setChecked(m_editModel->downsampleImages());
+    m_editModel->setImageTargetDpi(settings.value("Save/TargetDpi", ImageDownsampler::DEFAULT_TARGET_DPI).toInt());
+    m_editModel->setJpegQuality(settings.value("Save/JpegQuality", ImageDownsampler::DEFAULT_JPEG_QUALITY).toInt());
+
+    // 撤销/重做：菜单项随撤销栈的状态启用
+    connect(m_editModel->undoStack(), &QUndoStack::canUndoChanged, ui->actionUndo, &QAction::setEnabled);
+    connect(m_editModel->undoStack(), &QUndoStack::canRedoChanged, ui->actionRedo, &QAction::setEnabled);
+
+    // 编辑模式滚动时同步当前页码，页码切换时滚动到对应页面
+    connect(ui->pdfEditView, &PdfEditView::currentPageChanged, this, [this](int page){
+        if (ui->pdfView->pageNavigation()->currentPage() != page)
+            ui->pdfView->pageNavigation()->setCurrentPage(page);
+    });
+    connect(ui->pdfView->pageNavigation(), &QPdfPageNavigation::currentPageChanged, this, [this](int page){
+        if (ui->tabWidgetTools->currentWidget() == ui->editTab && ui->pdfEditView->currentPage() != page)
+            scrollToEditablePage(page);
+    });
 }
 
 MainWindow::~MainWindow()
 {
+    // 正常退出，不需要恢复
+    m_editJournal->stop();
+    // 先等待后台渲染结束，再释放文档
+    delete m_tileCache;
+    delete m_pageCache;
+    delete m_thumbnailModel;
     delete ui;
 }
 
-static int Pt2Px(double pt, QWidget* widget, int choice)
-{
-    int dpi = (choice == 0 ? widget->logicalDpiX(): widget->logicalDpiY());
-    qDebug() << "dpi:" << dpi << (choice == 0 ? "X" : "Y");
-    return pt/72*dpi;
-}
-
 void MainWindow::PoDoFoDemo(int choice)
 {
     try {
@@ -151,144 +225,43 @@ void MainWindow::PoDoFoDemo(int choice)
     }
 }
 
-void MainWindow::setEditablePageSize(double width, double height)
-{
-    // 设置页面大小，水平居中
-    ui->pdfPage->setFixedSize(::Pt2Px(width, ui->pdfPage, 0), ::Pt2Px(height, ui->pdfPage, 1));
-    QVBoxLayout layout;
-    layout.setAlignment(ui->pdfPage, Qt::AlignHCenter);
-}
-
 void MainWindow::loadEditablePDF()
 {
     qDebug() << "loadEditablePDF() >> dpi:" << this->screen()->logicalDotsPerInch();
-    // TODO: 没有切换文件则无需重新解析，继续使用上一次的编辑框
-    // 清除上一次的编辑框
-    for (auto& textEdit : m_textEdits) {
-        textEdit->hide();
-        delete textEdit;
-    }
-    m_textEdits.clear();
     if (m_docLocation.isLocalFile()) {
-        PdfMemDocument document;
-        try {
-            qDebug() << m_docLocation.toLocalFile();
-            document.Load(m_docLocation.toLocalFile().toStdString());
-
-            // TODO: 目前编辑状态只显示第一页，未实现页面切换
-            // pageIndex = pageNumber - 1
-            auto& page = document.GetPages().GetPageAt(m_pageSelector->getPageNumber()-1);
-
-            // TrimBox 定义了页面最终的尺寸
-            auto&& trimBox = page.GetTrimBox();
-            double width = trimBox.GetRight()-trimBox.GetLeft();
-            double height = trimBox.GetTop()-trimBox.GetBottom();
-            setEditablePageSize(width, height);
-
-            // 提取文本内容和位置
-            std::vector<PdfTextEntry> entries;
-            page.ExtractTextTo(entries);
-
-            // 提取文本字体状态
-            std::vector<UPdfTextState> textStates;
-            UPdfExtractTextStates(page, textStates);
-
-            qDebug() << "entries:" << entries.size() << ", states:" << textStates.size();
-
-            for (int i=0; i<entries.size(); i++) {
-                auto& entry = entries[i];
-                auto& currentState = textStates[i];
-
-                qDebug() << QString("(%1,%2) %3 %4")
-                                .arg(QString::number(entry.X), QString::number(entry.Y),
-                                     QString::number(entry.Length), entry.Text.data());
-
-                // e.g. baseFontName: "Times", fontName: "Times-BoldItalic"
-                qDebug() << currentState.font;
-
-                QString baseFontName, fontName;
-                if (currentState.font != nullptr) {
-                    baseFontName = currentState.font->GetMetrics().GetBaseFontName().data();
-                    fontName = currentState.font->GetMetrics().GetFontName().data();
-                }
-                qDebug() << "baseFontName:" << baseFontName << "fontName:" << fontName
-                         << "fontSize:" << currentState.fontSize;
-
-                QTextEdit *textEdit = new QTextEdit();
-                textEdit->setParent(ui->pdfPage);
-
-                // 设置字体格式
-                QFont::StyleHint fontHint = QFont::System;
-                QFont::Style fontStyle = QFont::StyleNormal;
-                QFont::Weight fontWeight = QFont::Weight::Normal;
-                PdfFont2QFont(baseFontName, fontName, fontHint, fontStyle, fontWeight);
-
-                QFont currentFont(fontName, currentState.fontSize);
-                currentFont.setStyle(fontStyle);
-                currentFont.setWeight(fontWeight);
-                currentFont.setStyleHint(fontHint);
-
-                textEdit->setCurrentFont(currentFont);
-                textEdit->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-                textEdit->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-
-                currentFont = textEdit->currentFont();
-
-                // 文本位置坐标转换成像素位置，在编辑区域生成可编辑的文本框
-                // 1. 计算宽高，需测量当前字体字符的宽高
-                QFontMetrics fm(currentFont);
-                int width = fm.horizontalAdvance(entry.Text.data()), height = fm.height();
-                const int horizontalMargin = 15, verticalMargin = 12;
-
-                // 2. 计算左上角坐标
-                // BUG: 编辑模式显示的文本位置比正常位置偏下
-                // FIX: 文本 entry.Y 是左下角的 Y，需加上字体高度才能得到左上角的 Y
-                auto&& trimBox = page.GetTrimBox();
-                int x = ::Pt2Px(entry.X-trimBox.GetLeft(), ui->pdfPage, 0);
-                int y = ::Pt2Px(trimBox.GetTop()-entry.Y, ui->pdfPage, 1) - height;
-
-                textEdit->setGeometry({x, y, width+horizontalMargin, height+verticalMargin});
-                qDebug() << "Rect:" << x << "," << y << "," << width << "," << height;
-
-                textEdit->append(entry.Text.data());
-                textEdit->show();
-                qDebug() << "Content size:" << textEdit->document()->size();
-
-                // 文本框大小自适应，宽度高度随着内容改变
-                connect(textEdit, &QTextEdit::textChanged, textEdit, [=](){
-                    // 计算最长的一行文本宽度（单位：像素）
-                    QString text = textEdit->toPlainText();
-                    int maxWidth = 0, lastIndex = 0, lineCount = 1;
-                    QFontMetrics fm(textEdit->currentFont());
-                    for (int i=0; i<text.length(); i++) {
-                        if (text[i] != '\n')
-                            continue;
-                        // 根据 font 计算文本宽度
-                        int width = fm.horizontalAdvance(text.mid(lastIndex, i-lastIndex));
-                        if (width > maxWidth)
-                            maxWidth = width;
-                        lastIndex = i;
-                        lineCount++;
-                    }
-                    int width = fm.horizontalAdvance(text.right(text.length()-lastIndex));
-                    if (width > maxWidth)
-                        maxWidth = width;
-
-                    textEdit->resize({maxWidth+horizontalMargin, fm.height()*lineCount+verticalMargin});
-                });
-
-                // 记录文本原始坐标
-                m_textPositions.append({entry.X, entry.Y});
-                // 保存文本框指针
-                m_textEdits.append(textEdit);
+        // 没有切换文件则无需重新解析，继续使用上一次的编辑框
+        const QString fileName = m_docLocation.toLocalFile();
+        if (m_editModel->fileName() != fileName) {
+            try {
+                m_editModel->load(fileName);
             }
+            catch (PdfError& e) {
+                // TODO: 目前不支持解析没有 xref 的 PDF，后续可以加入 xref 补全
+                e.PrintErrorMsg();
+                QString msg = QString::fromStdString(std::string(e.ErrorMessage(e.GetCode())));
+                QMessageBox::critical(this, tr("Failed to open"), msg);
+                return;
+            }
+
+            // 上次异常退出时留下了编辑日志，询问是否恢复未保存的修改
+            if (EditJournal::isRecoverable(fileName)) {
+                auto reply = QMessageBox::question(
+                    this, tr("Recover edits"),
+                    tr("Unsaved edits from a previous session were found.\n"
+                       "Do you want to recover them?"),
+                    QMessageBox::Yes | QMessageBox::No);
+                if (reply == QMessageBox::Yes)
+                    m_editJournal->replay();
+            }
+            m_editJournal->start();
         }
-        catch (PdfError& e) {
-            // TODO: 目前不支持解析没有 xref 的 PDF，后续可以加入 xref 补全
-            e.PrintErrorMsg();
-            QString msg = QString::fromStdString(std::string(e.ErrorMessage(e.GetCode())));
-            QMessageBox::critical(this, tr("Failed to open"), msg);
-        }
+
+        // 滚动到阅读模式的当前页，等滚动区域按新的页面尺寸更新后再滚动
+        // pageIndex = pageNumber - 1
+        const int pageIndex = m_pageSelector->getPageNumber()-1;
+        QTimer::singleShot(0, this, [this, pageIndex]() {
+            scrollToEditablePage(pageIndex);
+        });
 
     } else {
         qCDebug(lcExample) << m_docLocation << "is not a valid local file";
@@ -296,10 +269,24 @@ void MainWindow::loadEditablePDF()
     }
 }
 
+void MainWindow::scrollToEditablePage(int pageIndex)
+{
+    if (pageIndex < 0 || pageIndex >= m_editModel->pageCount())
+        return;
+    ui->pdfEditor->verticalScrollBar()->setValue(ui->pdfEditView->pageRect(pageIndex).top());
+}
+
 void MainWindow::open(const QUrl &docLocation)
 {
     if (docLocation.isLocalFile()) {
         m_docLocation = docLocation;
+        // 旧文档的页面图片、页面背景和编辑框作废
+        m_pageCache->clear();
+        m_tileCache->clear();
+        m_editJournal->stop();
+        m_editModel->clear();
+        // 缩略图的磁盘缓存按文件指纹区分，文件名在加载前设置
+        m_thumbnailModel->setFileName(docLocation.toLocalFile());
         m_document->load(docLocation.toLocalFile());
         // FIX: 窗口标题应该显示文件名，而不是 PDF 元数据中的 Title
         const auto documentTitle = docLocation.fileName();
@@ -335,53 +322,205 @@ void MainWindow::on_actionQuit_triggered()
     QApplication::quit();
 }
 
+bool MainWindow::saveEditablePDF(const QString &fileName, const std::function<bool()> &start)
+{
+    // 保存在后台线程进行，这里显示进度并等待完成，期间界面仍可响应
+    QProgressDialog progress(tr("Saving %1...").arg(QFileInfo(fileName).fileName()), tr("Cancel"),
+                             0, EditModel::SAVE_PROGRESS_MAX, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(500);
+    progress.setValue(0);
+
+    bool succeeded = false;
+    QString message;
+    QEventLoop loop;
+    connect(m_editModel, &EditModel::saveProgress, &progress, &QProgressDialog::setValue);
+    connect(&progress, &QProgressDialog::canceled, m_editModel, &EditModel::cancelSave);
+    connect(m_editModel, &EditModel::saveFinished, &loop, [&](bool ok, const QString &msg) {
+        succeeded = ok;
+        message = msg;
+        loop.quit();
+    });
+    if (!start())
+        return false;
+    loop.exec();
+
+    disconnect(m_editModel, &EditModel::saveProgress, &progress, &QProgressDialog::setValue);
+    // 取消时 message 为空，不需要提示
+    if (!succeeded && !message.isEmpty())
+        QMessageBox::critical(this, tr("Failed to save"), message);
+
+    // 优化保存时在状态栏显示各类对象节省的字节数
+    const QMap<QString, qint64>& savedBytes = m_editModel->savedBytes();
+    if (succeeded && !savedBytes.isEmpty()) {
+        qint64 total = 0;
+        QStringList details;
+        for (auto it = savedBytes.cbegin(); it != savedBytes.cend(); ++it) {
+            total += it.value();
+            details << QString("%1 %2").arg(it.key(), locale().formattedDataSize(it.value()));
+        }
+        statusBar()->showMessage(tr("Optimized: %1 saved (%2)")
+                                 .arg(locale().formattedDataSize(total), details.join(", ")));
+    }
+    return succeeded;
+}
+
+void MainWindow::on_actionSave_triggered()
+{
+    if (!m_editModel->document() || !m_editModel->isDirty() || m_editModel->isSaving())
+        return;
+
+    // 增量更新写入临时文件，成功后替换原文件
+    const QString fileName = m_editModel->fileName();
+    if (!saveEditablePDF(fileName, [=]() { return m_editModel->save(fileName); }))
+        return;
+    // 修改已写入原文件，日志以新文件为基础重新开始
+    m_editJournal->start();
+
+    // 阅读模式和页面背景重新加载保存后的文件，保持当前页
+    const int page = ui->pdfView->pageNavigation()->currentPage();
+    m_pageCache->clear();
+    m_tileCache->clear();
+    m_document->load(m_editModel->fileName());
+    ui->pdfView->pageNavigation()->setCurrentPage(page);
+}
+
 void MainWindow::on_actionSave_As_triggered()
 {
+    if (!m_editModel->document() || m_editModel->isSaving())
+        return;
+
     // 指定保存文件路径
     QUrl toSave = QFileDialog::getSaveFileUrl(this, tr("Save a PDF"), QUrl(), "Portable Documents (*.pdf)");
+    if (!toSave.isValid())
+        return;
     QString outputfile = toSave.toLocalFile();
     qDebug() << "outputfile:" << outputfile;
 
-    PdfMemDocument document;
-    PdfPainter painter;
+    // 复制原文件，再以增量更新的方式追加修改，图片、矢量图形和其他页面都保持原样
+    if (!saveEditablePDF(outputfile, [=]() { return m_editModel->save(outputfile); }))
+        return;
 
-    // TODO: 目前只支持单页编辑保存，多页编辑保存待实现
-    auto& page = document.GetPages().CreatePage(PdfPage::CreateStandardPageSize(PdfPageSize::A4));
-    painter.SetCanvas(page);
+    // 打开保存的文件
+    auto reply = QMessageBox::question(
+        this, tr("Open output file"),
+        tr("PDF file saved successfully.\n"
+           "Do you want to open it?"),
+        QMessageBox::Yes | QMessageBox::No);
 
-    // 依次将每个文本框的内容写入 PDF 页面
-    for (int i=0; i<m_textEdits.size(); i++) {
-        auto& textEdit = m_textEdits[i];
-        auto& pos = m_textPositions[i];
+    if (reply == QMessageBox::Yes) {
+        open(toSave);
+    }
+}
 
-        // 获取字体
-        QString fontName;
-        QFont qfont = textEdit->currentFont();
-        QFont2PdfFont(qfont, fontName);
+void MainWindow::on_actionExport_Text_triggered()
+{
+    if (!m_editModel->document() || m_editModel->isSaving())
+        return;
 
-        PdfFontSearchParams params;
-        params.AutoSelect = PdfFontAutoSelectBehavior::Standard14;
-        PdfFont* font = document.GetFonts().SearchFont(fontName.toStdString(), params);
-        qDebug() << "fontName:" << fontName;
+    // 指定导出文件路径
+    QUrl toExport = QFileDialog::getSaveFileUrl(this, tr("Export text"), QUrl(), "Portable Documents (*.pdf)");
+    if (!toExport.isValid())
+        return;
+    QString outputfile = toExport.toLocalFile();
+    qDebug() << "outputfile:" << outputfile;
 
-        painter.TextState.SetFont(*font, qfont.pointSize());
-        painter.DrawText(textEdit->toPlainText().toStdString(), pos.x(), pos.y());
-    }
-    painter.FinishDrawing();
-    document.Save(outputfile.toStdString());
+    // 只导出每页的文本（包含修改），逐页写入文件
+    if (!saveEditablePDF(outputfile, [=]() { return m_editModel->exportTextLayer(outputfile); }))
+        return;
 
-    // 打开保存的文件
+    // 打开导出的文件
     auto reply = QMessageBox::question(
         this, tr("Open output file"),
-        tr("PDF file saved successfully.\n"
+        tr("PDF file exported successfully.\n"
            "Do you want to open it?"),
         QMessageBox::Yes | QMessageBox::No);
 
     if (reply == QMessageBox::Yes) {
-        open(toSave);
+        open(toExport);
     }
 }
 
+void MainWindow::on_actionCompression_Level_triggered()
+{
+    // -1 为 zlib 默认级别
+    bool ok = false;
+    const int level = QInputDialog::getInt(this, tr("Compression Level"),
+                                           tr("Compression level (0-9, -1 for default):"),
+                                           m_editModel->compressionLevel(), -1, 9, 1, &ok);
+    if (!ok)
+        return;
+    m_editModel->setCompressionLevel(level);
+    QSettings settings;
+    settings.setValue("Save/CompressionLevel", m_editModel->compressionLevel());
+}
+
+void MainWindow::on_actionCompact_Save_triggered(bool checked)
+{
+    m_editModel->setCompactSave(checked);
+    QSettings settings;
+    settings.setValue("Save/Compact", checked);
+}
+
+void MainWindow::on_actionOptimize_on_Save_triggered(bool checked)
+{
+    m_editModel->setOptimizeSave(checked);
+    QSettings settings;
+    settings.setValue("Save/Optimize", checked);
+}
+
+void MainWindow::on_actionReproducible_Save_triggered(bool checked)
+{
+    m_editModel->setReproducibleSave(checked);
+    QSettings settings;
+    settings.setValue("Save/Reproducible", checked);
+}
+
+void MainWindow::on_actionFast_Web_View_triggered(bool checked)
+{
+    m_editModel->setLinearizeSave(checked);
+    QSettings settings;
+    settings.setValue("Save/Linearize", checked);
+}
+
+void MainWindow::on_actionDownsample_Images_triggered(bool checked)
+{
+    m_editModel->setDownsampleImages(checked);
+    QSettings settings;
+    settings.setValue("Save/Downsample", checked);
+}
+
+void MainWindow::on_actionImage_Resolution_triggered()
+{
+    // 目标分辨率按图片在页面上的尺寸计算，屏幕阅读 150 dpi 足够，打印可取 300 dpi
+    bool ok = false;
+    const int dpi = QInputDialog::getInt(this, tr("Image Resolution"),
+                                         tr("Downsample images above (dpi):"),
+                                         m_editModel->imageTargetDpi(), 36, 2400, 1, &ok);
+    if (!ok)
+        return;
+    const int quality = QInputDialog::getInt(this, tr("Image Resolution"),
+                                             tr("JPEG quality (1-100):"),
+                                             m_editModel->jpegQuality(), 1, 100, 1, &ok);
+    if (!ok)
+        return;
+    m_editModel->setImageTargetDpi(dpi);
+    m_editModel->setJpegQuality(quality);
+    QSettings settings;
+    settings.setValue("Save/TargetDpi", m_editModel->imageTargetDpi());
+    settings.setValue("Save/JpegQuality", m_editModel->jpegQuality());
+}
+
+void MainWindow::on_actionUndo_triggered()
+{
+    m_editModel->undoStack()->undo();
+}
+
+void MainWindow::on_actionRedo_triggered()
+{
+    m_editModel->undoStack()->redo();
+}
+
 void MainWindow::on_actionAbout_triggered()
 {
     QMessageBox::about(this, tr("About UntitledPDF"),
@@ -395,12 +534,12 @@ void MainWindow::on_actionAbout_Qt_triggered()
 
 void MainWindow::on_actionZoom_In_triggered()
 {
-    ui->pdfView->setZoomFactor(ui->pdfView->zoomFactor() * zoomMultiplier);
+    ui->pdfView->requestZoomFactor(ui->pdfView->pendingZoomFactor() * zoomMultiplier);
 }
 
 void MainWindow::on_actionZoom_Out_triggered()
 {
-    ui->pdfView->setZoomFactor(ui->pdfView->zoomFactor() / zoomMultiplier);
+    ui->pdfView->requestZoomFactor(ui->pdfView->pendingZoomFactor() / zoomMultiplier);
 }
 
 void MainWindow::on_actionPrevious_Page_triggered()
@@ -418,6 +557,23 @@ void MainWindow::on_actionContinuous_triggered()
     ui->pdfView->setPageMode(ui->actionContinuous->isChecked() ? QPdfView::MultiPage : QPdfView::SinglePage);
 }
 
+void MainWindow::on_actionPage_Cache_triggered()
+{
+    // 命中率低说明上限太小，来回滚动时仍在重新渲染
+    bool ok = false;
+    const int budget = QInputDialog::getInt(this, tr("Page Cache"),
+                                            tr("Memory budget in MB (%1 used, %2 hits, %3 misses):")
+                                            .arg(locale().formattedDataSize(m_pageCache->cachedBytes()))
+                                            .arg(m_pageCache->hitCount())
+                                            .arg(m_pageCache->missCount()),
+                                            m_pageCache->budget(), 16, 4096, 16, &ok);
+    if (!ok)
+        return;
+    m_pageCache->setBudget(budget);
+    QSettings settings;
+    settings.setValue("View/PageCacheBudget", m_pageCache->budget());
+}
+
 void MainWindow::on_actionPoDoFo_Helloworld_triggered()
 {
     PoDoFoDemo(DEMO_HELLOWORLD);
@@ -0,0 +1,192 @@
+#include "pageimagecache.h"
+
+#include <QPdfDocument>
+#include <QThread>
+
+#include <cmath>
+
+// 线程池按优先级排队，预渲染排在可见页面之后
+static const int VisiblePriority = 1;
+static const int PrefetchPriority = 0;
+
+// 预渲染任务的状态：开始渲染和被可见页面的请求抢占只有一个能成功
+enum PrefetchState {
+    PrefetchQueued,
+    PrefetchStarted,
+    PrefetchPromoted,
+};
+
+bool operator==(const PageImageKey& lhs, const PageImageKey& rhs)
+{
+    return lhs.page == rhs.page && lhs.zoom == rhs.zoom && lhs.dpr == rhs.dpr
+        && lhs.rotation == rhs.rotation;
+}
+
+uint qHash(const PageImageKey& key, uint seed)
+{
+    return qHash(key.page, seed) ^ qHash(key.zoom, seed << 1) ^ qHash(key.dpr, seed << 2)
+        ^ qHash(key.rotation, seed << 3);
+}
+
+PageImageCache::PageImageCache(QObject *parent)
+    : QObject(parent)
+    , m_document(nullptr)
+    , m_generation(0)
+    , m_renderGeneration(0)
+    , m_prefetchGeneration(0)
+    , m_hits(0)
+    , m_misses(0)
+{
+    // 留一个核心给 GUI 线程
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    setBudget(DEFAULT_BUDGET);
+}
+
+PageImageCache::~PageImageCache()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void PageImageCache::setDocument(QPdfDocument *document)
+{
+    m_document = document;
+    clear();
+}
+
+void PageImageCache::setBudget(int megabytes)
+{
+    // cost 的单位是 KB
+    m_images.setMaxCost(qMax(1, megabytes) * 1024);
+}
+
+QImage PageImageCache::image(int page, qreal zoom, qreal dpr, QPdfDocumentRenderOptions::Rotation rotation, const QSize &size)
+{
+    PageImageKey key { page, qRound(zoom * 1000), qRound(dpr * 1000), int(rotation) };
+    if (CachedImage *cached = m_images.object(key)) {
+        m_hits++;
+        return cached->image;
+    }
+
+    m_misses++;
+    requestImage(key, size);
+    return QImage();
+}
+
+QImage PageImageCache::closestImage(int page, qreal zoom, qreal dpr, QPdfDocumentRenderOptions::Rotation rotation)
+{
+    // 按设备像素的缩放比例比较，放大一倍与缩小一半的差距相同
+    const qreal target = zoom * dpr;
+    QImage closest;
+    qreal closestDistance = 0;
+    for (auto it = m_index.cbegin(); it != m_index.cend(); ++it) {
+        const PageImageKey& key = it.key();
+        if (key.page != page || key.rotation != int(rotation))
+            continue;
+        const qreal distance = qAbs(std::log(key.zoom * key.dpr / 1e6 / target));
+        if (closest.isNull() || distance < closestDistance) {
+            closest = it.value();
+            closestDistance = distance;
+        }
+    }
+    return closest;
+}
+
+void PageImageCache::cancelPending()
+{
+    m_renderGeneration++;
+}
+
+void PageImageCache::prefetch(int page, qreal zoom, qreal dpr, QPdfDocumentRenderOptions::Rotation rotation, const QSize &size)
+{
+    PageImageKey key { page, qRound(zoom * 1000), qRound(dpr * 1000), int(rotation) };
+    // contains() 不改变 LRU 顺序
+    if (!m_images.contains(key))
+        requestImage(key, size, true);
+}
+
+void PageImageCache::cancelPrefetch()
+{
+    m_prefetchGeneration++;
+}
+
+void PageImageCache::resetStatistics()
+{
+    m_hits = 0;
+    m_misses = 0;
+}
+
+void PageImageCache::clear()
+{
+    // 尚未开始的渲染作废，并等待正在进行的渲染结束，之后才能重新加载文档
+    m_generation++;
+    m_renderGeneration++;
+    m_pool.clear();
+    m_pool.waitForDone();
+    m_images.clear();
+    m_pending.clear();
+    m_prefetching.clear();
+}
+
+void PageImageCache::requestImage(const PageImageKey &key, const QSize &size, bool prefetch)
+{
+    if (!m_document || size.isEmpty())
+        return;
+    if (m_pending.contains(key)) {
+        // 可见页面的图片还在预渲染的队列中：取消预渲染，按可见页面的优先级重新排队
+        // 预渲染已经开始时等待它完成
+        const auto state = m_prefetching.value(key);
+        int queued = PrefetchQueued;
+        if (prefetch || !state || !state->compare_exchange_strong(queued, PrefetchPromoted))
+            return;
+        m_prefetching.remove(key);
+    }
+    m_pending.insert(key);
+    std::shared_ptr<std::atomic<int>> state;
+    if (prefetch) {
+        state = std::make_shared<std::atomic<int>>(PrefetchQueued);
+        m_prefetching.insert(key, state);
+    }
+
+    // QPdfDocument::render 内部持有 pdfium 的全局锁，可以在工作线程调用
+    QPdfDocument *document = m_document;
+    const int generation = m_generation;
+    const int renderGeneration = m_renderGeneration;
+    const int prefetchGeneration = m_prefetchGeneration;
+    m_pool.start([=]() {
+        // 被抢占的预渲染：可见页面的渲染已经重新排队
+        int queued = PrefetchQueued;
+        if (state && !state->compare_exchange_strong(queued, PrefetchStarted))
+            return;
+        if (renderGeneration != m_renderGeneration || (prefetch && prefetchGeneration != m_prefetchGeneration)) {
+            // 作废的渲染：页面可能仍然可见，通知视图按当前的缩放重新请求
+            QMetaObject::invokeMethod(this, [=]() {
+                if (generation != m_generation)
+                    return;
+                m_pending.remove(key);
+                m_prefetching.remove(key);
+                emit pageReady(key.page);
+            }, Qt::QueuedConnection);
+            return;
+        }
+
+        QPdfDocumentRenderOptions options;
+        options.setRotation(QPdfDocumentRenderOptions::Rotation(key.rotation));
+        const QImage image = document->render(key.page, size, options);
+
+        QMetaObject::invokeMethod(this, [=]() {
+            // 文档已重新加载，丢弃过期的结果
+            if (generation != m_generation)
+                return;
+            m_pending.remove(key);
+            m_prefetching.remove(key);
+            if (image.isNull())
+                return;
+            // 替换同一键的旧图片时，旧对象先从索引中移除
+            m_images.insert(key, new CachedImage(m_index, key, image), qMax(1, int(image.sizeInBytes() / 1024)));
+            if (m_images.contains(key))
+                m_index.insert(key, image);
+            emit pageReady(key.page);
+        }, Qt::QueuedConnection);
+    }, prefetch ? PrefetchPriority : VisiblePriority);
+}
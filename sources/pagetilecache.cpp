@@ -0,0 +1,112 @@
+#include "pagetilecache.h"
+
+#include <QPdfDocument>
+#include <QPdfDocumentRenderOptions>
+#include <QRect>
+#include <QThread>
+#include <QtMath>
+
+bool operator==(const PageTileKey& lhs, const PageTileKey& rhs)
+{
+    return lhs.page == rhs.page && lhs.zoom == rhs.zoom && lhs.dpr == rhs.dpr
+        && lhs.column == rhs.column && lhs.row == rhs.row;
+}
+
+uint qHash(const PageTileKey& key, uint seed)
+{
+    return qHash(key.page, seed) ^ qHash(key.zoom, seed << 1) ^ qHash(key.dpr, seed << 2)
+        ^ qHash((key.column << 16) | (key.row & 0xFFFF), seed << 3);
+}
+
+PageTileCache::PageTileCache(QObject *parent)
+    : QObject(parent)
+    , m_document(nullptr)
+    , m_generation(0)
+    , m_zoom(0)
+{
+    // 留一个核心给 GUI 线程
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    setBudget(64);
+}
+
+PageTileCache::~PageTileCache()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void PageTileCache::setDocument(QPdfDocument *document)
+{
+    m_document = document;
+    clear();
+}
+
+void PageTileCache::setBudget(int megabytes)
+{
+    // cost 的单位是 KB
+    m_tiles.setMaxCost(megabytes * 1024);
+}
+
+QImage PageTileCache::tile(int page, qreal zoom, qreal dpr, int column, int row, const QSize &pageSize)
+{
+    PageTileKey key { page, qRound(zoom * 1000), qRound(dpr * 1000), column, row };
+    m_zoom = key.zoom;
+    if (QImage *image = m_tiles.object(key))
+        return *image;
+
+    requestTile(key, pageSize);
+    return QImage();
+}
+
+void PageTileCache::clear()
+{
+    // 正在渲染的块仍在使用旧文档，重新加载前必须等待结束
+    m_generation++;
+    m_pool.clear();
+    m_pool.waitForDone();
+    m_tiles.clear();
+    m_pending.clear();
+}
+
+void PageTileCache::requestTile(const PageTileKey &key, const QSize &pageSize)
+{
+    if (!m_document || m_pending.contains(key))
+        return;
+
+    const QRect tileRect = QRect(key.column * TILE_SIZE, key.row * TILE_SIZE, TILE_SIZE, TILE_SIZE)
+                               .intersected(QRect(QPoint(0, 0), pageSize));
+    if (tileRect.isEmpty())
+        return;
+
+    m_pending.insert(key);
+
+    // QPdfDocument::render 内部持有 pdfium 的全局锁，可以在工作线程调用
+    QPdfDocument *document = m_document;
+    const int generation = m_generation;
+    m_pool.start([=]() {
+        // 文档已重新加载，或缩放已经改变
+        if (generation != m_generation || key.zoom != m_zoom) {
+            QMetaObject::invokeMethod(this, [=]() {
+                if (generation == m_generation)
+                    m_pending.remove(key);
+            }, Qt::QueuedConnection);
+            return;
+        }
+
+        QPdfDocumentRenderOptions options;
+        options.setScaledSize(pageSize);
+        options.setScaledClipRect(tileRect);
+        const QImage image = document->render(key.page, tileRect.size(), options);
+
+        QMetaObject::invokeMethod(this, [=]() {
+            // 文档已重新加载，丢弃过期的结果
+            if (generation != m_generation)
+                return;
+            m_pending.remove(key);
+            if (image.isNull())
+                return;
+            m_tiles.insert(key, new QImage(image), qMax(1, int(image.sizeInBytes() / 1024)));
+            emit tileReady(key.page);
+        }, Qt::QueuedConnection);
+    });
+}
@@ -0,0 +1,444 @@
+#include "pdfeditview.h"
+#include "editmodel.h"
+#include "fontmetricscache.h"
+#include "pdfpagewidget.h"
+
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPolygonF>
+#include <QSignalBlocker>
+#include <QTextEdit>
+#include <QTimer>
+
+#include <algorithm>
+
+// 页面之间及页面与视图边缘的间距（单位：px）
+static const int PAGE_MARGIN = 6;
+
+// PDF 用户空间（单位：pt，y 轴向上）=> 设备像素（y 轴向下），原点为 TrimBox 左上角
+// x' = (x - left) * scaleX, y' = (top - y) * scaleY
+static QTransform PdfToDeviceTransform(const QRectF& trimBox, qreal dpiX, qreal dpiY, qreal zoom, qreal dpr)
+{
+    const qreal scaleX = dpiX / 72 * zoom * dpr, scaleY = dpiY / 72 * zoom * dpr;
+    const double trimTop = trimBox.y() + trimBox.height();
+    return QTransform(scaleX, 0, 0, -scaleY, -trimBox.x() * scaleX, trimTop * scaleY);
+}
+
+PdfEditView::PdfEditView(QWidget *parent)
+    : QWidget(parent)
+    , m_model(nullptr)
+    , m_tileCache(nullptr)
+    , m_zoomMode(QPdfView::CustomZoom)
+    , m_zoomFactor(1.0)
+    , m_zoom(1.0)
+    , m_currentPage(-1)
+    , m_updatePending(false)
+{
+    // 样式表中的背景色需要此属性才会绘制
+    setAttribute(Qt::WA_StyledBackground);
+}
+
+PdfEditView::~PdfEditView()
+{
+}
+
+void PdfEditView::setTileCache(PageTileCache *tileCache)
+{
+    m_tileCache = tileCache;
+}
+
+void PdfEditView::setZoomMode(QPdfView::ZoomMode mode)
+{
+    m_zoomMode = mode;
+    updateZoom();
+}
+
+void PdfEditView::setZoomFactor(qreal factor)
+{
+    m_zoomFactor = factor;
+    updateZoom();
+}
+
+void PdfEditView::updateZoom()
+{
+    qreal zoom = m_zoomFactor;
+    QWidget *viewport = parentWidget();
+    if (m_zoomMode != QPdfView::CustomZoom && viewport && !m_pages.isEmpty()) {
+        // 以最宽（最高）的页面适应视口
+        qreal maxWidth = 0, maxHeight = 0;
+        for (const auto& slot : m_pages) {
+            maxWidth = qMax(maxWidth, slot.trimBox.width() * logicalDpiX() / 72);
+            maxHeight = qMax(maxHeight, slot.trimBox.height() * logicalDpiY() / 72);
+        }
+        zoom = (viewport->width() - 2 * PAGE_MARGIN) / maxWidth;
+        if (m_zoomMode == QPdfView::FitInView)
+            zoom = qMin(zoom, (viewport->height() - 2 * PAGE_MARGIN) / maxHeight);
+    }
+    if (zoom <= 0 || qFuzzyCompare(zoom, m_zoom))
+        return;
+    m_zoom = zoom;
+
+    // 缩放只替换页面变换：不重新提取页面，也不重建文本框
+    setUpdatesEnabled(false);
+    layoutPages();
+    for (int pageIndex : m_residentPages) {
+        m_pages[pageIndex].widget->setZoom(m_zoom);
+        layoutTextEdits(pageIndex);
+    }
+    setUpdatesEnabled(true);
+    scheduleUpdate();
+}
+
+void PdfEditView::setModel(EditModel *model)
+{
+    if (m_model)
+        disconnect(m_model, nullptr, this, nullptr);
+    m_model = model;
+    if (m_model) {
+        connect(m_model, &EditModel::modelReset, this, &PdfEditView::onModelReset);
+        connect(m_model, &EditModel::runChanged, this, &PdfEditView::onRunChanged);
+    }
+    onModelReset();
+}
+
+void PdfEditView::onModelReset()
+{
+    for (int pageIndex : QVector<int>(m_residentPages))
+        releasePage(pageIndex);
+    m_pages.clear();
+    m_currentPage = -1;
+    setMinimumSize(0, 0);
+
+    if (!m_model)
+        return;
+
+    m_pages.resize(m_model->pageCount());
+    for (int i=0; i<m_pages.size(); i++)
+        m_pages[i].trimBox = m_model->pageTrimBox(i);
+
+    layoutPages();
+    updateZoom();
+    scheduleUpdate();
+}
+
+void PdfEditView::onRunChanged(int pageIndex, int runIndex)
+{
+    // 只更新被修改的文本框，页面未驻留时无需处理
+    if (pageIndex < 0 || pageIndex >= m_pages.size() || !m_pages[pageIndex].widget)
+        return;
+    const PageSlot& slot = m_pages[pageIndex];
+
+    QTextEdit *textEdit = slot.textEdits[runIndex];
+    const UPdfTextRun& run = m_model->run({ pageIndex, runIndex }).run;
+    // 撤销等操作从模型修改文本，内容与编辑框一致时不要重置光标
+    // 同步时不能再触发 textChanged，否则会向撤销栈压入新命令、清空重做
+    if (textEdit->toPlainText() != run.text) {
+        const QSignalBlocker blocker(textEdit);
+        textEdit->setPlainText(run.text);
+    }
+    layoutTextEdit(pageIndex, runIndex, slot.transform.map(run.pos) / devicePixelRatioF());
+}
+
+QRect PdfEditView::pageRect(int pageIndex) const
+{
+    return m_pages.value(pageIndex).rect;
+}
+
+bool PdfEditView::eventFilter(QObject *watched, QEvent *event)
+{
+    // 鼠标事件发给文本框的 viewport
+    if (event->type() == QEvent::MouseButtonPress || event->type() == QEvent::MouseMove
+            || event->type() == QEvent::MouseButtonRelease) {
+        QTextEdit *textEdit = qobject_cast<QTextEdit *>(watched->parent());
+        if (textEdit != nullptr && dragTextEdit(textEdit, static_cast<QMouseEvent *>(event)))
+            return true;
+    }
+
+    // QTextEdit 会抢先处理撤销/重做的快捷键，这里让给窗口的菜单项
+    if (event->type() == QEvent::ShortcutOverride) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        if (keyEvent->matches(QKeySequence::Undo) || keyEvent->matches(QKeySequence::Redo)) {
+            event->ignore();
+            return true;
+        }
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void PdfEditView::moveEvent(QMoveEvent *event)
+{
+    // QScrollArea 通过移动内容控件实现滚动
+    QWidget::moveEvent(event);
+    scheduleUpdate();
+}
+
+void PdfEditView::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    // 适应宽度/页面时，缩放比例随视口大小变化
+    if (m_zoomMode != QPdfView::CustomZoom)
+        updateZoom();
+    layoutPages();
+    scheduleUpdate();
+}
+
+void PdfEditView::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    scheduleUpdate();
+}
+
+void PdfEditView::scheduleUpdate()
+{
+    // 同一轮事件循环中的多次滚动只处理一次
+    if (m_updatePending)
+        return;
+    m_updatePending = true;
+    QTimer::singleShot(0, this, &PdfEditView::updateResidentPages);
+}
+
+void PdfEditView::layoutPages()
+{
+    // 页面纵向排列，水平居中
+    // 每页只计算一次 PDF => 设备像素的变换，页面尺寸和文本框位置都由它得出
+    const qreal dpr = devicePixelRatioF();
+    int maxWidth = 0, y = PAGE_MARGIN;
+    for (auto& slot : m_pages) {
+        slot.transform = PdfToDeviceTransform(slot.trimBox, logicalDpiX(), logicalDpiY(), m_zoom, dpr);
+        const QRectF deviceRect = slot.transform.mapRect(slot.trimBox);
+        QSize size(qRound(deviceRect.width() / dpr), qRound(deviceRect.height() / dpr));
+        slot.rect = QRect(QPoint(0, y), size);
+        maxWidth = qMax(maxWidth, size.width());
+        y += size.height() + PAGE_MARGIN;
+    }
+    setMinimumSize(maxWidth + 2 * PAGE_MARGIN, y);
+
+    const int viewWidth = qMax(width(), minimumWidth());
+    for (auto& slot : m_pages) {
+        slot.rect.moveLeft((viewWidth - slot.rect.width()) / 2);
+        if (slot.widget)
+            slot.widget->setGeometry(slot.rect);
+    }
+}
+
+void PdfEditView::updateResidentPages()
+{
+    m_updatePending = false;
+    if (m_pages.isEmpty())
+        return;
+
+    const QRect visible = visibleRegion().boundingRect();
+    if (visible.isEmpty())
+        return;
+
+    // 上下各预加载一屏，超过两屏的页面释放
+    const QRect nearby = visible.adjusted(0, -visible.height(), 0, visible.height());
+    const QRect keep = visible.adjusted(0, -2 * visible.height(), 0, 2 * visible.height());
+    auto distance = [&](int pageIndex) {
+        return qAbs(m_pages[pageIndex].rect.center().y() - visible.center().y());
+    };
+
+    // 页面按 y 有序排列，二分查找第一个进入预加载范围的页面
+    auto first = std::lower_bound(m_pages.cbegin(), m_pages.cend(), nearby.top(),
+                                  [](const PageSlot& slot, int top) { return slot.rect.bottom() < top; });
+    QVector<int> wanted;
+    int currentPage = -1, currentArea = 0;
+    for (auto it = first; it != m_pages.cend() && it->rect.top() <= nearby.bottom(); ++it) {
+        const int pageIndex = int(it - m_pages.cbegin());
+        wanted.append(pageIndex);
+
+        // 可见面积最大的页面作为当前页
+        const QRect visiblePart = it->rect.intersected(visible);
+        const int area = visiblePart.width() * visiblePart.height();
+        if (area > currentArea) {
+            currentArea = area;
+            currentPage = pageIndex;
+        }
+    }
+
+    // 距离可视区域中心越近越先生成，超过上限的页面不生成
+    std::sort(wanted.begin(), wanted.end(), [&](int a, int b) { return distance(a) < distance(b); });
+    if (wanted.size() > MAX_RESIDENT_PAGES)
+        wanted.resize(MAX_RESIDENT_PAGES);
+    // 生成页面期间暂停绘制，全部生成后只重绘一次
+    setUpdatesEnabled(false);
+    for (int pageIndex : wanted) {
+        if (!m_pages[pageIndex].widget)
+            materializePage(pageIndex);
+    }
+
+    // 从最远的页面开始释放：超出保留范围，或驻留页数超过上限
+    QVector<int> residents = m_residentPages;
+    std::sort(residents.begin(), residents.end(), [&](int a, int b) { return distance(a) > distance(b); });
+    for (int pageIndex : residents) {
+        if (wanted.contains(pageIndex))
+            continue;
+        if (!m_pages[pageIndex].rect.intersects(keep) || m_residentPages.size() > MAX_RESIDENT_PAGES)
+            releasePage(pageIndex);
+    }
+    setUpdatesEnabled(true);
+
+    if (currentPage >= 0 && currentPage != m_currentPage) {
+        m_currentPage = currentPage;
+        emit currentPageChanged(m_currentPage);
+    }
+}
+
+void PdfEditView::materializePage(int pageIndex)
+{
+    // 第一次访问时模型才提取页面文本
+    const int runCount = m_model->pageRuns(pageIndex).size();
+    PageSlot& slot = m_pages[pageIndex];
+
+    // 页面在全部文本框生成、定位之后才显示，文本框的字体、内容和位置各只设置一次，
+    // 整页只做一次定位，显示后统一绘制
+    PdfPageWidget *pageWidget = new PdfPageWidget(this);
+    // 文本框继承页面的白色背景，遮住背景中原有的文字
+    pageWidget->setStyleSheet("background-color:#FFFFFF");
+    pageWidget->setTileCache(m_tileCache);
+    pageWidget->setPageIndex(pageIndex);
+    pageWidget->setZoom(m_zoom);
+    pageWidget->setGeometry(slot.rect);
+
+    slot.widget = pageWidget;
+    slot.textEdits.reserve(runCount);
+    for (int i=0; i<runCount; i++)
+        slot.textEdits.append(createTextEdit(pageWidget, pageIndex, i));
+    layoutTextEdits(pageIndex);
+
+    pageWidget->show();
+    m_residentPages.append(pageIndex);
+}
+
+void PdfEditView::releasePage(int pageIndex)
+{
+    // 文本框的修改已经实时写回模型，直接销毁控件即可
+    PageSlot& slot = m_pages[pageIndex];
+    if (m_drag.textEdit != nullptr && m_drag.pageIndex == pageIndex)
+        m_drag.textEdit = nullptr;
+    delete slot.widget;
+    slot.widget = nullptr;
+    slot.textEdits.clear();
+    m_residentPages.removeOne(pageIndex);
+}
+
+// 文本框大小随内容变化：宽度取最长一行，高度取行数（单位：像素）
+static QSize TextBoxSize(const QFont& font, const QString& text)
+{
+    const int horizontalMargin = 15, verticalMargin = 12;
+    int maxWidth = 0, lastIndex = 0, lineCount = 1;
+    auto& metricsCache = FontMetricsCache::instance();
+    for (int i=0; i<text.length(); i++) {
+        if (text[i] != '\n')
+            continue;
+        // 根据 font 计算文本宽度
+        int width = metricsCache.horizontalAdvance(font, text.mid(lastIndex, i-lastIndex));
+        if (width > maxWidth)
+            maxWidth = width;
+        lastIndex = i + 1;
+        lineCount++;
+    }
+    int width = metricsCache.horizontalAdvance(font, text.right(text.length()-lastIndex));
+    if (width > maxWidth)
+        maxWidth = width;
+
+    return {maxWidth+horizontalMargin, metricsCache.height(font)*lineCount+verticalMargin};
+}
+
+QFont PdfEditView::displayFont(const QFont& font) const
+{
+    // 字体的 pt 到像素的换算与页面变换使用相同的 DPI，只需乘以缩放比例
+    if (font.pointSizeF() <= 0)
+        return font;
+    QFont scaled(font);
+    scaled.setPointSizeF(font.pointSizeF() * m_zoom);
+    return scaled;
+}
+
+QTextEdit* PdfEditView::createTextEdit(PdfPageWidget *pageWidget, int pageIndex, int runIndex)
+{
+    const UPdfTextRun& run = m_model->run({ pageIndex, runIndex }).run;
+
+    QTextEdit *textEdit = new QTextEdit(pageWidget);
+    // 字体设置在文档的默认字体上，缩放时只需替换默认字体，不需要重建文本框
+    textEdit->document()->setDefaultFont(displayFont(run.font));
+    textEdit->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    textEdit->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    // 撤销/重做统一由模型的撤销栈处理，快捷键交给窗口的菜单项
+    textEdit->setUndoRedoEnabled(false);
+    textEdit->installEventFilter(this);
+    textEdit->viewport()->installEventFilter(this);
+    textEdit->setPlainText(run.text);
+
+    // 修改写回模型，页面释放后不会丢失；模型通过 runChanged 调整文本框大小
+    connect(textEdit, &QTextEdit::textChanged, this, [=](){
+        m_model->setText({ pageIndex, runIndex }, textEdit->toPlainText());
+    });
+    return textEdit;
+}
+
+void PdfEditView::layoutTextEdits(int pageIndex)
+{
+    PageSlot& slot = m_pages[pageIndex];
+    const QVector<EditRun>& runs = m_model->pageRuns(pageIndex);
+
+    // 一次性把整页文本的 PDF 坐标变换成设备像素
+    QPolygonF positions(runs.size());
+    for (int i=0; i<runs.size(); i++)
+        positions[i] = runs[i].run.pos;
+    positions = slot.transform.map(positions);
+
+    const qreal dpr = devicePixelRatioF();
+    for (int i=0; i<slot.textEdits.size(); i++)
+        layoutTextEdit(pageIndex, i, positions[i] / dpr);
+}
+
+void PdfEditView::layoutTextEdit(int pageIndex, int runIndex, const QPointF &baseline)
+{
+    QTextEdit *textEdit = m_pages[pageIndex].textEdits[runIndex];
+    const QFont font = displayFont(m_model->run({ pageIndex, runIndex }).run.font);
+    if (textEdit->document()->defaultFont() != font)
+        textEdit->document()->setDefaultFont(font);
+
+    // 文本位置坐标转换成像素位置
+    // FIX: 文本 pos.y 是左下角的 Y，需减去字体高度才能得到左上角的 Y
+    const int x = qRound(baseline.x());
+    const int y = qRound(baseline.y()) - FontMetricsCache::instance().height(font);
+    textEdit->setGeometry(QRect(QPoint(x, y), TextBoxSize(font, textEdit->toPlainText())));
+}
+
+bool PdfEditView::dragTextEdit(QTextEdit *textEdit, QMouseEvent *event)
+{
+    // 按住 Alt 拖动文本框移动文本，一次拖动中的移动在撤销栈中合并为一步
+    switch (event->type()) {
+    case QEvent::MouseButtonPress: {
+        if (event->button() != Qt::LeftButton || !(event->modifiers() & Qt::AltModifier))
+            return false;
+        const int pageIndex = static_cast<PdfPageWidget *>(textEdit->parentWidget())->pageIndex();
+        m_drag.textEdit = textEdit;
+        m_drag.pageIndex = pageIndex;
+        m_drag.runIndex = m_pages[pageIndex].textEdits.indexOf(textEdit);
+        m_drag.gesture = m_model->beginGesture();
+        m_drag.start = event->globalPos();
+        m_drag.origin = m_model->run({ pageIndex, m_drag.runIndex }).run.pos;
+        return true;
+    }
+    case QEvent::MouseMove: {
+        if (m_drag.textEdit != textEdit)
+            return false;
+        // 鼠标位移换算成设备像素，经页面变换的逆变换得到新的 PDF 坐标
+        const QTransform& transform = m_pages[m_drag.pageIndex].transform;
+        const QPointF delta = QPointF(event->globalPos() - m_drag.start) * devicePixelRatioF();
+        const QPointF pos = transform.inverted().map(transform.map(m_drag.origin) + delta);
+        m_model->setPos({ m_drag.pageIndex, m_drag.runIndex }, pos, m_drag.gesture);
+        return true;
+    }
+    case QEvent::MouseButtonRelease:
+        if (m_drag.textEdit != textEdit)
+            return false;
+        m_drag.textEdit = nullptr;
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,73 @@
+#include "pdfpagewidget.h"
+#include "pagetilecache.h"
+
+#include <QPaintEvent>
+#include <QPainter>
+
+PdfPageWidget::PdfPageWidget(QWidget *parent)
+    : QWidget(parent)
+    , m_tileCache(nullptr)
+    , m_pageIndex(-1)
+    , m_zoom(1.0)
+{
+    // 背景由 paintEvent 完整绘制
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void PdfPageWidget::setTileCache(PageTileCache *tileCache)
+{
+    if (m_tileCache)
+        disconnect(m_tileCache, nullptr, this, nullptr);
+    m_tileCache = tileCache;
+    if (m_tileCache)
+        connect(m_tileCache, &PageTileCache::tileReady, this, &PdfPageWidget::onTileReady);
+    update();
+}
+
+void PdfPageWidget::setPageIndex(int pageIndex)
+{
+    m_pageIndex = pageIndex;
+    update();
+}
+
+void PdfPageWidget::setZoom(qreal zoom)
+{
+    m_zoom = zoom;
+    update();
+}
+
+void PdfPageWidget::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    // 块尚未渲染完成的区域先显示白色
+    painter.fillRect(event->rect(), Qt::white);
+
+    if (!m_tileCache || m_pageIndex < 0)
+        return;
+
+    // 块按设备像素划分，绘制时换算回逻辑坐标
+    const qreal dpr = devicePixelRatioF();
+    const QSize pageSize = (QSizeF(size()) * dpr).toSize();
+    const QRect dirty = QRectF(QRectF(event->rect()).topLeft() * dpr,
+                               QRectF(event->rect()).size() * dpr).toAlignedRect();
+    const int tileSize = PageTileCache::TILE_SIZE;
+
+    const int firstColumn = dirty.left() / tileSize, lastColumn = dirty.right() / tileSize;
+    const int firstRow = dirty.top() / tileSize, lastRow = dirty.bottom() / tileSize;
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int column = firstColumn; column <= lastColumn; column++) {
+            const QImage tile = m_tileCache->tile(m_pageIndex, m_zoom, dpr, column, row, pageSize);
+            if (tile.isNull())
+                continue;
+            const QRectF target(column * tileSize / dpr, row * tileSize / dpr,
+                                tile.width() / dpr, tile.height() / dpr);
+            painter.drawImage(target, tile);
+        }
+    }
+}
+
+void PdfPageWidget::onTileReady(int page)
+{
+    if (page == m_pageIndex)
+        update();
+}
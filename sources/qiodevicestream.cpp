@@ -0,0 +1,56 @@
+#include "qiodevicestream.h"
+
+using namespace PoDoFo;
+
+QIODeviceOutputStream::QIODeviceOutputStream(QIODevice &device, std::function<void(qint64)> progress)
+    : m_device(device)
+    , m_progress(progress)
+    , m_written(0)
+    , m_deferErrors(false)
+    , m_discard(false)
+{
+}
+
+size_t QIODeviceOutputStream::GetLength() const
+{
+    return size_t(m_device.size());
+}
+
+size_t QIODeviceOutputStream::GetPosition() const
+{
+    return size_t(m_device.pos());
+}
+
+void QIODeviceOutputStream::writeBuffer(const char* buffer, size_t size)
+{
+    if (m_discard)
+        return;
+    if (m_device.write(buffer, qint64(size)) != qint64(size)) {
+        if (!m_deferErrors)
+            throw PdfError(PdfErrorCode::InvalidDeviceOperation, __FILE__, __LINE__,
+                           m_device.errorString().toStdString());
+        m_error = m_device.errorString();
+        m_discard = true;
+        return;
+    }
+    m_written += qint64(size);
+    if (m_progress)
+        m_progress(m_written);
+}
+
+void QIODeviceOutputStream::flush()
+{
+    // QSaveFile 等设备在 commit/close 时统一写入磁盘
+}
+
+void QIODeviceOutputStream::seek(ssize_t offset, SeekDirection direction)
+{
+    qint64 pos = qint64(offset);
+    if (direction == SeekDirection::Current)
+        pos += m_device.pos();
+    else if (direction == SeekDirection::End)
+        pos += m_device.size();
+    if (!m_device.seek(pos))
+        throw PdfError(PdfErrorCode::InvalidDeviceOperation, __FILE__, __LINE__,
+                       m_device.errorString().toStdString());
+}
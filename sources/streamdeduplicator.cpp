@@ -0,0 +1,244 @@
+#include "streamdeduplicator.h"
+#include "tools.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QVector>
+
+using namespace PoDoFo;
+
+// 合并后可能出现新的相同对象（如引用了相同字体文件的字体描述），最多重复的轮数
+static const int MaxMergePasses = 8;
+
+// 用于比较的对象内容：流为去掉 /Length 的字典加上未解码的数据，其余为对象的值
+static QByteArray ObjectContent(const PdfObject &object)
+{
+    if (!object.HasStream())
+        return QByteArray::fromStdString(object.GetVariant().ToString());
+
+    PdfDictionary dictionary = object.GetDictionary();
+    dictionary.RemoveKey("Length");
+    QByteArray content = QByteArray::fromStdString(PdfObject(dictionary).ToString());
+    const charbuff data = object.GetStream()->GetCopy(true);
+    content.append("stream", 6);
+    content.append(data.data(), int(data.size()));
+    return content;
+}
+
+// 统计节省的字节数时使用的分类
+static QString ObjectCategory(const PdfObject &object)
+{
+    const PdfDictionary* dictionary = nullptr;
+    if (!object.TryGetDictionary(dictionary))
+        return object.IsArray() ? "Array" : "Other";
+
+    const PdfName* type = nullptr;
+    const PdfName* subtype = nullptr;
+    const PdfObject* value = dictionary->GetKey("Type");
+    if (value != nullptr)
+        value->TryGetName(type);
+    value = dictionary->GetKey("Subtype");
+    if (value != nullptr)
+        value->TryGetName(subtype);
+
+    if (object.HasStream()) {
+        const std::string name = subtype != nullptr ? subtype->GetString() : std::string();
+        if (name == "Image" || name == "Form")
+            return QString::fromStdString(name);
+        // 字体文件没有 /Type，按 /Length1 ~ /Length3 或嵌入格式识别
+        if (dictionary->HasKey("Length1") || dictionary->HasKey("Length2")
+                || name == "Type1C" || name == "CIDFontType0C" || name == "OpenType")
+            return "FontFile";
+    }
+    if (type != nullptr)
+        return QString::fromStdString(type->GetString());
+    return object.HasStream() ? "Stream" : "Other";
+}
+
+// 页面的内容流和内容数组，合并后修改一页会影响另一页
+static QSet<quint64> PageContents(PdfDocument &document)
+{
+    QSet<quint64> contents;
+    auto& pages = document.GetPages();
+    for (unsigned i=0; i<pages.GetCount(); i++) {
+        const PdfDictionary& dictionary = pages.GetPageAt(i).GetDictionary();
+        PdfReference ref;
+        const PdfObject* value = dictionary.GetKey("Contents");
+        if (value != nullptr && value->TryGetReference(ref))
+            contents.insert(UPdfReferenceKey(ref));
+        const PdfArray* array = nullptr;
+        value = dictionary.FindKey("Contents");
+        if (value != nullptr && value->TryGetArray(array)) {
+            for (const auto& item : *array) {
+                if (item.TryGetReference(ref))
+                    contents.insert(UPdfReferenceKey(ref));
+            }
+        }
+    }
+    return contents;
+}
+
+// 字体的 /Widths 和 CID 字体的 /W 数组，其余数组（如 /Kids、/Annots）合并后可能被单独修改
+static QSet<quint64> WidthArrays(PdfDocument &document)
+{
+    QSet<quint64> arrays;
+    for (const PdfObject* object : document.GetObjects()) {
+        const PdfDictionary* dictionary = nullptr;
+        const PdfName* type = nullptr;
+        if (!object->TryGetDictionary(dictionary))
+            continue;
+        const PdfObject* value = dictionary->GetKey("Type");
+        if (value == nullptr || !value->TryGetName(type) || type->GetString() != "Font")
+            continue;
+        for (const char* key : { "Widths", "W" }) {
+            PdfReference ref;
+            value = dictionary->GetKey(key);
+            if (value != nullptr && value->TryGetReference(ref))
+                arrays.insert(UPdfReferenceKey(ref));
+        }
+    }
+    return arrays;
+}
+
+// 参与合并的对象：除页面内容以外的流，以及字体、字体描述和字体的宽度数组
+static bool IsMergeable(const PdfObject &object, const QSet<quint64> &pageContents, const QSet<quint64> &widthArrays)
+{
+    const quint64 key = UPdfReferenceKey(object.GetIndirectReference());
+    if (pageContents.contains(key))
+        return false;
+    if (object.HasStream())
+        return true;
+    if (object.IsArray())
+        return widthArrays.contains(key);
+
+    const PdfDictionary* dictionary = nullptr;
+    const PdfName* type = nullptr;
+    if (!object.TryGetDictionary(dictionary))
+        return false;
+    const PdfObject* value = dictionary->GetKey("Type");
+    return value != nullptr && value->TryGetName(type)
+            && (type->GetString() == "Font" || type->GetString() == "FontDescriptor");
+}
+
+StreamDeduplicator::StreamDeduplicator(PdfDocument &document)
+    : m_document(document), m_removedCount(0)
+{
+
+}
+
+int StreamDeduplicator::run()
+{
+    m_savedBytes.clear();
+    m_removedCount = 0;
+    for (int pass=0; pass<MaxMergePasses; pass++) {
+        if (mergePass() == 0)
+            break;
+    }
+    removeUnreachable();
+    m_contents.clear();
+    return m_removedCount;
+}
+
+qint64 StreamDeduplicator::totalSavedBytes() const
+{
+    qint64 total = 0;
+    for (qint64 bytes : m_savedBytes)
+        total += bytes;
+    return total;
+}
+
+int StreamDeduplicator::mergePass()
+{
+    PdfIndirectObjectList& objects = m_document.GetObjects();
+    const QSet<quint64> pageContents = PageContents(m_document);
+    const QSet<quint64> widthArrays = WidthArrays(m_document);
+
+    // 按内容的 qHash 和长度分组，组内逐字节比较确认相同
+    QHash<QPair<uint, int>, QVector<PdfObject*>> kept;
+    QHash<quint64, PdfReference> replaced;
+    QVector<PdfObject*> duplicates;
+    for (PdfObject* object : objects) {
+        if (!IsMergeable(*object, pageContents, widthArrays))
+            continue;
+
+        const QByteArray content = objectContent(*object);
+        QVector<PdfObject*>& candidates = kept[qMakePair(qHash(content), content.size())];
+        PdfObject* original = nullptr;
+        for (PdfObject* candidate : candidates) {
+            if (objectContent(*candidate) == content) {
+                original = candidate;
+                break;
+            }
+        }
+        if (original == nullptr) {
+            candidates.append(object);
+            continue;
+        }
+        replaced.insert(UPdfReferenceKey(object->GetIndirectReference()), original->GetIndirectReference());
+        duplicates.append(object);
+    }
+    if (duplicates.isEmpty())
+        return 0;
+
+    // 引用被替换的对象内容改变，下一轮重新序列化
+    for (PdfObject* object : objects) {
+        if (UPdfRewriteReferences(*object, replaced))
+            m_contents.remove(UPdfReferenceKey(object->GetIndirectReference()));
+    }
+    UPdfRewriteReferences(m_document.GetTrailer().GetObject(), replaced);
+
+    for (PdfObject* object : duplicates) {
+        const PdfReference ref = object->GetIndirectReference();
+        countRemoved(*object);
+        objects.RemoveObject(ref);
+    }
+    return duplicates.size();
+}
+
+void StreamDeduplicator::removeUnreachable()
+{
+    PdfIndirectObjectList& objects = m_document.GetObjects();
+
+    // 从文件尾的字典开始，沿引用找出所有可达的对象
+    QSet<quint64> reachable;
+    QVector<PdfReference> pending;
+    UPdfCollectReferences(m_document.GetTrailer().GetObject(), pending);
+    while (!pending.isEmpty()) {
+        const PdfReference ref = pending.takeLast();
+        if (reachable.contains(UPdfReferenceKey(ref)))
+            continue;
+        reachable.insert(UPdfReferenceKey(ref));
+        const PdfObject* object = objects.GetObject(ref);
+        if (object != nullptr)
+            UPdfCollectReferences(*object, pending);
+    }
+
+    QVector<PdfReference> unreachable;
+    for (PdfObject* object : objects) {
+        if (!reachable.contains(UPdfReferenceKey(object->GetIndirectReference()))) {
+            countRemoved(*object);
+            unreachable.append(object->GetIndirectReference());
+        }
+    }
+    for (const auto& ref : unreachable)
+        objects.RemoveObject(ref);
+}
+
+void StreamDeduplicator::countRemoved(const PdfObject &object)
+{
+    const quint64 key = UPdfReferenceKey(object.GetIndirectReference());
+    const QByteArray content = m_contents.contains(key) ? m_contents.take(key) : ObjectContent(object);
+    m_savedBytes[ObjectCategory(object)] += content.size();
+    m_removedCount++;
+}
+
+QByteArray StreamDeduplicator::objectContent(const PdfObject &object)
+{
+    const quint64 key = UPdfReferenceKey(object.GetIndirectReference());
+    auto it = m_contents.constFind(key);
+    if (it == m_contents.constEnd())
+        it = m_contents.insert(key, ObjectContent(object));
+    return it.value();
+}
@@ -0,0 +1,281 @@
+#include "thumbnailmodel.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QPdfDocument>
+#include <QStandardPaths>
+#include <QDebug>
+
+#include <algorithm>
+
+// 计算指纹时读取的首尾内容长度
+static const qint64 FingerprintChunk = 64 * 1024;
+// 每次打开文件时更新这个文件的修改时间，作为目录最近使用的时间
+static const char* UsedMarker = ".used";
+
+ThumbnailModel::ThumbnailModel(QObject *parent)
+    : QAbstractListModel(parent)
+    , m_document(nullptr)
+    , m_cacheReady(false)
+    , m_dpr(qApp->devicePixelRatio())
+    , m_running(0)
+    , m_generation(0)
+{
+    // 与阅读模式的页面渲染共用 CPU，缩略图只用两个线程
+    m_pool.setMaxThreadCount(2);
+    // cost 的单位是 KB
+    m_thumbnails.setMaxCost(MEMORY_BUDGET * 1024);
+}
+
+ThumbnailModel::~ThumbnailModel()
+{
+    m_queue.clear();
+    m_pool.waitForDone();
+}
+
+void ThumbnailModel::setDocument(QPdfDocument *document)
+{
+    if (m_document)
+        disconnect(m_document, nullptr, this, nullptr);
+    m_document = document;
+    if (m_document)
+        connect(m_document, &QPdfDocument::statusChanged, this, &ThumbnailModel::onDocumentStatusChanged);
+    onDocumentStatusChanged();
+}
+
+void ThumbnailModel::setFileName(const QString &fileName)
+{
+    m_fileName = fileName;
+}
+
+QString ThumbnailModel::fingerprint(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+
+    const QFileInfo info(fileName);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+    hash.addData(file.read(FingerprintChunk));
+    if (file.size() > FingerprintChunk) {
+        file.seek(qMax(FingerprintChunk, file.size() - FingerprintChunk));
+        hash.addData(file.read(FingerprintChunk));
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+int ThumbnailModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !m_document || m_document->status() != QPdfDocument::Ready)
+        return 0;
+    return m_document->pageCount();
+}
+
+QVariant ThumbnailModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount())
+        return QVariant();
+
+    const int page = index.row();
+    switch (role) {
+    case Qt::DisplayRole:
+        return QString::number(page + 1);
+    case Qt::DecorationRole:
+        // 视图只对可见的行取缩略图，未渲染的先显示空白页
+        if (QImage *thumbnail = m_thumbnails.object(page))
+            return *thumbnail;
+        requestThumbnail(page);
+        return m_placeholder;
+    case Qt::TextAlignmentRole:
+        return Qt::AlignCenter;
+    default:
+        return QVariant();
+    }
+}
+
+void ThumbnailModel::onDocumentStatusChanged()
+{
+    beginResetModel();
+    // 正在渲染的任务完成后按代数丢弃
+    m_queue.clear();
+    m_pending.clear();
+    m_thumbnails.clear();
+    m_generation++;
+    m_cacheDir.clear();
+    m_cacheReady = false;
+    m_pageSizes.clear();
+    m_placeholder = QImage();
+    // 卸载（Unloading）时文档还没有关闭，等待正在进行的渲染结束后才能关闭
+    m_pool.waitForDone();
+
+    if (m_document && m_document->status() == QPdfDocument::Ready && m_document->pageCount() > 0) {
+        m_pageSizes.reserve(m_document->pageCount());
+        for (int page = 0; page < m_document->pageCount(); page++)
+            m_pageSizes.append(m_document->pageSize(page));
+
+        // 读取文件和遍历目录可能较慢，不阻塞界面；在同一个线程池中，析构和重置时一起等待
+        const QString fileName = m_fileName;
+        const int generation = m_generation;
+        m_running++;
+        m_pool.start([this, fileName, generation]() {
+            const QString cacheDir = prepareDiskCache(fileName);
+            QMetaObject::invokeMethod(this, [=]() {
+                m_running--;
+                onDiskCacheReady(generation, cacheDir);
+            }, Qt::QueuedConnection);
+        });
+
+        // 视图的行高一致，空白页按第一页的比例生成
+        const QSizeF pageSize = m_pageSizes.first();
+        const int width = qRound(THUMBNAIL_WIDTH * m_dpr);
+        const int height = pageSize.width() > 0 ? qRound(width * pageSize.height() / pageSize.width()) : width;
+        m_placeholder = QImage(width, height, QImage::Format_RGB32);
+        m_placeholder.fill(Qt::white);
+        m_placeholder.setDevicePixelRatio(m_dpr);
+    }
+    endResetModel();
+}
+
+QString ThumbnailModel::prepareDiskCache(const QString &fileName)
+{
+    const QString fileFingerprint = fingerprint(fileName);
+    if (fileFingerprint.isEmpty())
+        return QString();
+    const QString root = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails";
+    const QString cacheDir = root + "/" + fileFingerprint;
+    QFile marker(cacheDir + "/" + UsedMarker);
+    if (!QDir().mkpath(cacheDir) || !marker.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return QString();
+    marker.close();
+    pruneDiskCache(root, cacheDir);
+    return cacheDir;
+}
+
+void ThumbnailModel::onDiskCacheReady(int generation, const QString &cacheDir)
+{
+    // 文档已重新加载，新的指纹另行计算
+    if (generation != m_generation)
+        return;
+    m_cacheDir = cacheDir;
+    m_cacheReady = true;
+    startJobs();
+}
+
+void ThumbnailModel::pruneDiskCache(const QString &root, const QString &current)
+{
+    struct CacheDir {
+        QString path;
+        QDateTime used;
+        qint64 size;
+    };
+    const QString currentPath = QFileInfo(current).absoluteFilePath();
+    QVector<CacheDir> dirs;
+    qint64 total = 0;
+    const QDateTime expired = QDateTime::currentDateTime().addDays(-DISK_MAX_AGE);
+    const QFileInfoList entries = QDir(root).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const auto& entry : entries) {
+        CacheDir dir { entry.absoluteFilePath(), entry.lastModified(), 0 };
+        const QFileInfo marker(dir.path + "/" + UsedMarker);
+        if (marker.exists())
+            dir.used = marker.lastModified();
+        const QFileInfoList files = QDir(dir.path).entryInfoList(QDir::Files | QDir::Hidden);
+        for (const auto& file : files)
+            dir.size += file.size();
+        if (dir.path != currentPath && dir.used < expired) {
+            QDir(dir.path).removeRecursively();
+            continue;
+        }
+        total += dir.size;
+        dirs.append(dir);
+    }
+
+    std::sort(dirs.begin(), dirs.end(), [](const CacheDir& a, const CacheDir& b) { return a.used < b.used; });
+    const qint64 budget = qint64(DISK_BUDGET) * 1024 * 1024;
+    for (const auto& dir : dirs) {
+        if (total <= budget)
+            break;
+        if (dir.path == currentPath)
+            continue;
+        if (QDir(dir.path).removeRecursively())
+            total -= dir.size;
+    }
+}
+
+QString ThumbnailModel::cacheFileName(int page) const
+{
+    if (m_cacheDir.isEmpty())
+        return QString();
+    return QString("%1/%2-%3.png").arg(m_cacheDir).arg(page).arg(qRound(THUMBNAIL_WIDTH * m_dpr));
+}
+
+void ThumbnailModel::requestThumbnail(int page) const
+{
+    // 已在等待的页面重新排到最前
+    if (m_pending.contains(page)) {
+        const int position = m_queue.indexOf(page);
+        if (position >= 0 && position != m_queue.size() - 1) {
+            m_queue.remove(position);
+            m_queue.append(page);
+        }
+        return;
+    }
+    m_pending.insert(page);
+    m_queue.append(page);
+    startJobs();
+}
+
+void ThumbnailModel::startJobs() const
+{
+    // 线程池只接收能立即执行的任务，排队由 m_queue 负责，这样最后请求的页面先处理
+    if (!m_cacheReady)
+        return;
+    while (m_running < m_pool.maxThreadCount() && !m_queue.isEmpty()) {
+        const int page = m_queue.takeLast();
+        const QSizeF pageSize = m_pageSizes.value(page);
+        const int width = qRound(THUMBNAIL_WIDTH * m_dpr);
+        const QSize size(width, pageSize.width() > 0 ? qRound(width * pageSize.height() / pageSize.width()) : width);
+        const QString fileName = cacheFileName(page);
+        const int generation = m_generation;
+        QPdfDocument *document = m_document;
+        ThumbnailModel *model = const_cast<ThumbnailModel *>(this);
+
+        m_running++;
+        m_pool.start([=]() {
+            // 先读磁盘缓存，没有时渲染并写入缓存
+            QImage image;
+            if (!fileName.isEmpty())
+                image.load(fileName, "PNG");
+            if (image.isNull()) {
+                image = document->render(page, size);
+                if (!image.isNull() && !fileName.isEmpty() && !image.save(fileName, "PNG"))
+                    qWarning() << "ThumbnailModel >> failed to write" << fileName;
+            }
+            QMetaObject::invokeMethod(model, [=]() {
+                model->onThumbnailReady(generation, page, image);
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void ThumbnailModel::onThumbnailReady(int generation, int page, const QImage &image)
+{
+    m_running--;
+    // 文档已重新加载，丢弃过期的结果
+    if (generation == m_generation) {
+        m_pending.remove(page);
+        if (!image.isNull()) {
+            QImage *thumbnail = new QImage(image);
+            thumbnail->setDevicePixelRatio(m_dpr);
+            m_thumbnails.insert(page, thumbnail, qMax(1, int(image.sizeInBytes() / 1024)));
+            const QModelIndex changed = index(page);
+            emit dataChanged(changed, changed, { Qt::DecorationRole });
+        }
+    }
+    startJobs();
+}
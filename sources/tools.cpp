@@ -166,73 +166,188 @@ void PoDoFoBase14Fonts(std::string outputfile)
     }
 }
 
+// PDF 中的空白字符
+static bool IsPdfWhitespace(char ch)
+{
+    return ch == '\0' || ch == '\t' || ch == '\n' || ch == '\f' || ch == '\r' || ch == ' ';
+}
+
+// 跳过空白和注释，返回下一个 token 的起始位置
+static size_t SkipPdfWhitespace(const charbuff& buffer, size_t pos)
+{
+    while (pos < buffer.size()) {
+        if (IsPdfWhitespace(buffer[pos])) {
+            pos++;
+        }
+        else if (buffer[pos] == '%') {
+            while (pos < buffer.size() && buffer[pos] != '\n' && buffer[pos] != '\r')
+                pos++;
+        }
+        else {
+            break;
+        }
+    }
+    return pos;
+}
+
+// 内联图片 BI ... ID <数据> EI：数据是二进制，不能交给 tokenizer，直接找到 EI 之后
+static size_t SkipInlineImageData(const charbuff& buffer, size_t pos)
+{
+    for (size_t i = pos + 1; i + 2 <= buffer.size(); i++) {
+        if (buffer[i] == 'E' && buffer[i+1] == 'I' && IsPdfWhitespace(buffer[i-1])
+                && (i + 2 == buffer.size() || IsPdfWhitespace(buffer[i+2]))) {
+            return i + 2;
+        }
+    }
+    return buffer.size();
+}
+
+// Tj 的运算对象是字符串，TJ 是字符串和间距组成的数组，转换成 UTF-8 文本
+static bool DecodeTextOperand(const PdfFont* font, const PdfVariant& operand, string& text)
+{
+    if (font == nullptr)
+        return false;
+    auto& encoding = font->GetEncoding();
+    if (operand.IsString())
+        return encoding.TryConvertToUtf8(operand.GetString(), text);
+    if (!operand.IsArray())
+        return false;
+
+    text.clear();
+    for (auto& item : operand.GetArray()) {
+        const PdfString* str;
+        if (!item.TryGetString(str))
+            continue;
+        string part;
+        if (!encoding.TryConvertToUtf8(*str, part))
+            return false;
+        text += part;
+    }
+    return true;
+}
+
 void UPdfExtractTextStates(PdfPage& page, vector<UPdfTextState>& textStates)
 {
+    auto contents = page.GetContents();
+    if (contents == nullptr)
+        return;
+
     try {
-        PdfContentStreamReader reader(page);
-        PdfContent content;
+        // 直接解析解码后的内容流，记录每个 Tj/TJ 运算对象在流中的位置，保存时只替换这一段
+        const charbuff buffer = contents->GetCopy();
+        SpanStreamDevice device(buffer);
+        PdfPostScriptTokenizer tokenizer;
+        PdfPostScriptTokenType tokenType;
+        string_view keyword;
+        PdfVariant variant;
+
+        vector<PdfVariant> operands;
+        size_t operandOffset = 0, operandLength = 0;
         UPdfTextState currentState;
 
-        while (reader.TryReadNext(content)) {
-            while (reader.TryReadNext(content)) {
-                switch (content.Type) {
-                case PdfContentType::Operator: {
-                    // 运算符不合法则忽略，继续解析
-                    if ((content.Warnings & PdfContentWarnings::InvalidOperator)
-                        != PdfContentWarnings::None) {
-                        continue;
-                    }
-                    switch (content.Operator) {
-                    case PdfOperator::TL:
-                    case PdfOperator::cm:
-                    case PdfOperator::Td:
-                    case PdfOperator::TD:
-                    case PdfOperator::Tm:
-                    case PdfOperator::T_Star:
-                    case PdfOperator::BT:
-                    case PdfOperator::ET: {
-                        break;
-                    }
-                    case PdfOperator::Tf: {     // 设置字体
-                        currentState.fontSize = content.Stack[0].GetReal();
-                        auto& fontName = content.Stack[1].GetName();
-                        currentState.font = page.GetResources()->GetFont(fontName);
-                        break;
-                    }
-                    case PdfOperator::Tj: {     // 显示当前文本
-                        // TODO: 文本与状态检查
-                        textStates.push_back(currentState);
-                        break;
-                    }
-                    case PdfOperator::Quote:
-                    case PdfOperator::DoubleQuote:{
-                        break;
-                    }
-                    case PdfOperator::TJ: {
-                        textStates.push_back(currentState);
-                        break;
-                    }
-                    case PdfOperator::Tc:
-                    case PdfOperator::Tw:
-                    case PdfOperator::q:
-                    case PdfOperator::Q:
-                    default:
-                        break;
-                    }
-                    break;
+        while (true) {
+            const size_t start = device.GetPosition();
+            if (!tokenizer.TryReadNext(device, tokenType, keyword, variant))
+                break;
+
+            if (tokenType == PdfPostScriptTokenType::Variant) {
+                operandOffset = SkipPdfWhitespace(buffer, start);
+                operandLength = device.GetPosition() - operandOffset;
+                operands.push_back(variant);
+                continue;
+            }
+            if (tokenType != PdfPostScriptTokenType::Keyword) {
+                operands.clear();
+                continue;
+            }
+
+            if (keyword == "Tf") {          // 设置字体
+                if (operands.size() >= 2 && operands[operands.size()-2].IsName()
+                        && operands.back().IsNumberOrReal()) {
+                    currentState.fontSize = operands.back().GetReal();
+                    auto& fontName = operands[operands.size()-2].GetName();
+                    currentState.font = page.GetResources()->GetFont(fontName);
                 }
-                case PdfContentType::ImageDictionary:
-                case PdfContentType::ImageData:
-                case PdfContentType::DoXObject:
-                case PdfContentType::EndXObjectForm:
-                default:
-                    break;
+            }
+            else if (keyword == "Tj" || keyword == "TJ") {  // 显示文本
+                UPdfTextState textState = currentState;
+                if (!operands.empty() && DecodeTextOperand(textState.font, operands.back(), textState.operandText)) {
+                    textState.operandOffset = operandOffset;
+                    textState.operandLength = operandLength;
                 }
+                textStates.push_back(textState);
+            }
+            else if (keyword == "ID") {     // 内联图片数据
+                device.Seek(SkipInlineImageData(buffer, device.GetPosition()));
             }
+            operands.clear();
         }
     }
-    catch (...) {
+    catch (PdfError& e) {
+        // 解析失败时保留已经得到的状态，缺少的部分使用默认值
+        e.PrintErrorMsg();
+    }
+}
 
+void UPdfExtractTextRuns(PdfPage& page, QVector<UPdfTextRun>& runs)
+{
+    // 提取文本内容和位置
+    vector<PdfTextEntry> entries;
+    page.ExtractTextTo(entries);
+
+    // 提取文本字体状态
+    vector<UPdfTextState> textStates;
+    UPdfExtractTextStates(page, textStates);
+
+    qDebug() << "entries:" << entries.size() << ", states:" << textStates.size();
+
+    runs.reserve(runs.size() + int(entries.size()));
+    for (size_t i=0; i<entries.size(); i++) {
+        auto& entry = entries[i];
+        // 状态数量与文本数量不一致时，缺少的状态使用默认值
+        UPdfTextState currentState = (i < textStates.size() ? textStates[i] : UPdfTextState());
+
+        // e.g. baseFontName: "Times", fontName: "Times-BoldItalic"
+        QString baseFontName, fontName;
+        if (currentState.font != nullptr) {
+            baseFontName = currentState.font->GetMetrics().GetBaseFontName().data();
+            fontName = currentState.font->GetMetrics().GetFontName().data();
+        }
+
+        // 设置字体格式
+        QFont::StyleHint fontHint = QFont::System;
+        QFont::Style fontStyle = QFont::StyleNormal;
+        QFont::Weight fontWeight = QFont::Weight::Normal;
+        PdfFont2QFont(baseFontName, fontName, fontHint, fontStyle, fontWeight);
+
+        QFont font(fontName, currentState.fontSize);
+        font.setStyle(fontStyle);
+        font.setWeight(fontWeight);
+        font.setStyleHint(fontHint);
+
+        // 原文本的区域：宽度取 entry.Length，高度取字体的 ascent 到 descent
+        double ascent = 0.8 * currentState.fontSize, descent = -0.2 * currentState.fontSize;
+        if (currentState.font != nullptr) {
+            PdfTextState state;
+            state.Font = currentState.font;
+            state.FontSize = currentState.fontSize;
+            state.FontScale = currentState.fontScale;
+            ascent = currentState.font->GetAscent(state);
+            descent = currentState.font->GetDescent(state);
+        }
+
+        UPdfTextRun run;
+        run.text = QString::fromStdString(entry.Text);
+        run.pos = QPointF(entry.X, entry.Y);
+        run.font = font;
+        run.bounds = QRectF(entry.X, entry.Y + descent, entry.Length, ascent - descent);
+        // 状态与文本按顺序对应，运算对象解码后与文本一致才能在保存时直接替换
+        if (currentState.operandLength > 0 && currentState.operandText == entry.Text) {
+            run.pdfFont = currentState.font;
+            run.operandOffset = qint64(currentState.operandOffset);
+            run.operandLength = qint64(currentState.operandLength);
+        }
+        runs.append(run);
     }
 }
 
@@ -351,3 +466,85 @@ void DemoBase14Fonts(PdfPainter& painter, PdfPage& page, PdfDocument& document)
         }
     }
 }
+
+quint64 UPdfReferenceKey(const PdfReference& ref)
+{
+    return (quint64(ref.ObjectNumber()) << 16) | ref.GenerationNumber();
+}
+
+void UPdfCollectReferences(const PdfObject& object, QVector<PdfReference>& references)
+{
+    PdfReference ref;
+    const PdfDictionary* dictionary = nullptr;
+    const PdfArray* array = nullptr;
+    if (object.TryGetReference(ref)) {
+        references.append(ref);
+    }
+    else if (object.TryGetDictionary(dictionary)) {
+        for (const auto& pair : *dictionary)
+            UPdfCollectReferences(pair.second, references);
+    }
+    else if (object.TryGetArray(array)) {
+        for (const auto& item : *array)
+            UPdfCollectReferences(item, references);
+    }
+}
+
+bool UPdfRewriteReferences(PdfObject& object, const QHash<quint64, PdfReference>& replaced)
+{
+    bool rewritten = false;
+    PdfReference ref;
+    if (object.TryGetReference(ref)) {
+        auto it = replaced.constFind(UPdfReferenceKey(ref));
+        if (it != replaced.constEnd()) {
+            object = PdfObject(it.value());
+            rewritten = true;
+        }
+    }
+    else if (object.IsDictionary()) {
+        for (auto& pair : object.GetDictionary())
+            rewritten |= UPdfRewriteReferences(pair.second, replaced);
+    }
+    else if (object.IsArray()) {
+        for (auto& item : object.GetArray())
+            rewritten |= UPdfRewriteReferences(item, replaced);
+    }
+    return rewritten;
+}
+
+QByteArray UPdfDeflate(const QByteArray& data, int level)
+{
+    // qCompress 在 zlib 数据前加了 4 字节的原始长度，FlateDecode 只需要后面的部分
+    return qCompress(data, level).mid(4);
+}
+
+QByteArray UPdfSerializeStream(uint32_t number, PdfDictionary& dictionary, const QByteArray& data)
+{
+    dictionary.AddKey("Length", PdfObject(int64_t(data.size())));
+    QByteArray serialized = QByteArray::fromStdString(to_string(number) + " 0 obj\n"
+                                                      + PdfObject(dictionary).ToString() + "\nstream\n");
+    serialized += data;
+    serialized += "\nendstream\nendobj\n";
+    return serialized;
+}
+
+QByteArray UPdfSerializeObject(const PdfObject& object, uint32_t number,
+                               const QHash<quint64, PdfReference>& numbers, int level)
+{
+    if (!object.HasStream()) {
+        PdfObject value(object.GetVariant());
+        UPdfRewriteReferences(value, numbers);
+        return QByteArray::fromStdString(to_string(number) + " 0 obj\n"
+                                         + value.GetVariant().ToString() + "\nendobj\n");
+    }
+
+    PdfObject dictionary(object.GetDictionary());
+    UPdfRewriteReferences(dictionary, numbers);
+    const charbuff raw = object.GetStream()->GetCopy(true);
+    QByteArray data(raw.data(), int(raw.size()));
+    if (!dictionary.GetDictionary().HasKey("Filter") && !data.isEmpty()) {
+        data = UPdfDeflate(data, level);
+        dictionary.GetDictionary().AddKey("Filter", PdfName("FlateDecode"));
+    }
+    return UPdfSerializeStream(number, dictionary.GetDictionary(), data);
+}
@@ -0,0 +1,24 @@
+# 编辑模型和保存时用到的模块
+QT += widgets
+
+SOURCES += \
+    $$ROOT/sources/compactwriter.cpp \
+    $$ROOT/sources/editmodel.cpp \
+    $$ROOT/sources/fontresolver.cpp \
+    $$ROOT/sources/imagedownsampler.cpp \
+    $$ROOT/sources/incrementalwriter.cpp \
+    $$ROOT/sources/linearizedwriter.cpp \
+    $$ROOT/sources/qiodevicestream.cpp \
+    $$ROOT/sources/streamdeduplicator.cpp \
+    $$ROOT/sources/tools.cpp
+
+HEADERS += \
+    $$ROOT/headers/compactwriter.h \
+    $$ROOT/headers/editmodel.h \
+    $$ROOT/headers/fontresolver.h \
+    $$ROOT/headers/imagedownsampler.h \
+    $$ROOT/headers/incrementalwriter.h \
+    $$ROOT/headers/linearizedwriter.h \
+    $$ROOT/headers/qiodevicestream.h \
+    $$ROOT/headers/streamdeduplicator.h \
+    $$ROOT/headers/tools.h
@@ -0,0 +1,77 @@
+#ifndef TESTDOCUMENT_H
+#define TESTDOCUMENT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <string>
+
+#include <podofo/podofo.h>
+
+// 测试用的 PDF：每页一行 Helvetica 文本 "Page n"
+inline QByteArray CreateTestDocument(int pageCount = 2)
+{
+    using namespace PoDoFo;
+    PdfMemDocument document;
+    PdfFont& font = document.GetFonts().GetStandard14Font(PdfStandard14FontType::Helvetica);
+    PdfPainter painter;
+    for (int i=0; i<pageCount; i++) {
+        PdfPage& page = document.GetPages().CreatePage(PdfPage::CreateStandardPageSize(PdfPageSize::A4));
+        painter.SetCanvas(page);
+        painter.TextState.SetFont(font, 12);
+        painter.DrawText("Page " + std::to_string(i + 1), 72, 720);
+        painter.FinishDrawing();
+    }
+    charbuff buffer;
+    BufferStreamDevice device(buffer);
+    document.Save(device);
+    return QByteArray(buffer.data(), int(buffer.size()));
+}
+
+inline void LoadDocument(PoDoFo::PdfMemDocument &document, const QByteArray &data)
+{
+    document.LoadFromBuffer(PoDoFo::bufferview(data.constData(), size_t(data.size())));
+}
+
+inline QByteArray ToByteArray(const PoDoFo::charbuff &buffer)
+{
+    return QByteArray(buffer.data(), int(buffer.size()));
+}
+
+// 页面解码后的内容，多个内容流时拼接
+inline QByteArray PageContents(PoDoFo::PdfMemDocument &document, unsigned pageIndex)
+{
+    return ToByteArray(document.GetPages().GetPageAt(pageIndex).MustGetContents().GetCopy());
+}
+
+// 对象的值和解码后的流，用于比较写入前后的对象
+inline QByteArray ObjectContent(const PoDoFo::PdfObject &object)
+{
+    QByteArray content = QByteArray::fromStdString(object.GetVariant().ToString());
+    if (object.HasStream())
+        content += ToByteArray(object.GetStream()->GetCopy());
+    return content;
+}
+
+// 文档中全部字体的 /BaseFont，排序后比较
+inline QStringList FontNames(PoDoFo::PdfMemDocument &document)
+{
+    using namespace PoDoFo;
+    QStringList names;
+    for (const PdfObject* object : document.GetObjects()) {
+        const PdfDictionary* dictionary = nullptr;
+        const PdfName* name = nullptr;
+        if (!object->TryGetDictionary(dictionary))
+            continue;
+        const PdfObject* type = dictionary->GetKey("Type");
+        const PdfObject* baseFont = dictionary->GetKey("BaseFont");
+        if (type != nullptr && type->TryGetName(name) && name->GetString() == "Font"
+                && baseFont != nullptr && baseFont->TryGetName(name))
+            names.append(QString::fromStdString(name->GetString()));
+    }
+    names.sort();
+    return names;
+}
+
+#endif // TESTDOCUMENT_H
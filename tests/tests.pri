@@ -0,0 +1,24 @@
+QT += core gui testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+msvc:QMAKE_CXXFLAGS += /utf-8
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+ROOT = $$PWD/..
+
+# 3rdparty
+INCLUDEPATH += \
+    $$ROOT/3rdparty/PoDoFo/include
+
+LIBS += \
+    -L"$$ROOT/3rdparty/PoDoFo/lib" -lpodofo
+
+INCLUDEPATH += \
+    $$ROOT/headers \
+    $$PWD
+
+HEADERS += \
+    $$PWD/testdocument.h
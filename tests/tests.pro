@@ -0,0 +1,10 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    tst_compactwriter \
+    tst_editjournal \
+    tst_editmodel \
+    tst_incrementalwriter \
+    tst_linearizedwriter \
+    tst_pageimagecache \
+    tst_streamdeduplicator
@@ -0,0 +1,105 @@
+#include "compactwriter.h"
+#include "incrementalwriter.h"
+#include "testdocument.h"
+
+#include <QBuffer>
+#include <QtTest>
+
+using namespace PoDoFo;
+
+class TestCompactWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void deterministicId();
+    void incrementalUpdateAfterCompact();
+
+private:
+    static QByteArray WriteCompact(const QByteArray &source, bool deterministic = false);
+};
+
+QByteArray TestCompactWriter::WriteCompact(const QByteArray &source, bool deterministic)
+{
+    PdfMemDocument document;
+    LoadDocument(document, source);
+    CompactWriter writer(document);
+    writer.setDeterministicId(deterministic);
+    charbuff buffer;
+    {
+        BufferStreamDevice device(buffer);
+        writer.write(device);
+    }
+    return ToByteArray(buffer);
+}
+
+void TestCompactWriter::roundTrip()
+{
+    const QByteArray source = CreateTestDocument(3);
+    PdfMemDocument original;
+    LoadDocument(original, source);
+
+    PdfMemDocument document;
+    LoadDocument(document, source);
+    CompactWriter writer(document);
+    charbuff buffer;
+    {
+        BufferStreamDevice device(buffer);
+        writer.write(device);
+    }
+    QVERIFY(writer.packedObjectCount() > 0);
+    QVERIFY(writer.objectStreamCount() > 0);
+
+    // 对象流和交叉引用流可以被 PoDoFo 读回，页面内容和字体不变
+    PdfMemDocument reloaded;
+    LoadDocument(reloaded, ToByteArray(buffer));
+    QCOMPARE(reloaded.GetPages().GetCount(), original.GetPages().GetCount());
+    for (unsigned i=0; i<original.GetPages().GetCount(); i++) {
+        QCOMPARE(PageContents(reloaded, i), PageContents(original, i));
+        QCOMPARE(reloaded.GetPages().GetPageAt(i).GetMediaBox().ToString(),
+                 original.GetPages().GetPageAt(i).GetMediaBox().ToString());
+    }
+    QCOMPARE(FontNames(reloaded), FontNames(original));
+}
+
+void TestCompactWriter::deterministicId()
+{
+    // 相同的内容写出相同的字节，包括文件标识符
+    const QByteArray source = CreateTestDocument();
+    QCOMPARE(WriteCompact(source, true), WriteCompact(source, true));
+}
+
+void TestCompactWriter::incrementalUpdateAfterCompact()
+{
+    // 最后一节是交叉引用流时，增量更新也写为交叉引用流
+    QByteArray compact = WriteCompact(CreateTestDocument());
+    PdfMemDocument document;
+    LoadDocument(document, compact);
+
+    const uint32_t size = uint32_t(document.GetTrailer().GetDictionary().MustFindKey("Size").GetNumber());
+    IncrementalWriter writer(document.GetTrailer().GetDictionary(), size);
+    PdfPage& page = document.GetPages().GetPageAt(1);
+    PdfObject dictionary(page.GetDictionary());
+    dictionary.GetDictionary().AddKey("UPdfTest", PdfObject(true));
+    writer.setObject(page.GetObject().GetIndirectReference(), dictionary);
+
+    QBuffer source(&compact);
+    source.open(QIODevice::ReadOnly);
+    charbuff buffer;
+    {
+        BufferStreamDevice device(buffer);
+        writer.write(source, device);
+    }
+    const QByteArray output = ToByteArray(buffer);
+    QVERIFY(output.mid(compact.size()).contains("/XRef"));
+
+    PdfMemDocument reloaded;
+    LoadDocument(reloaded, output);
+    QVERIFY(reloaded.GetPages().GetPageAt(1).GetDictionary().HasKey("UPdfTest"));
+    QCOMPARE(PageContents(reloaded, 0), PageContents(document, 0));
+}
+
+QTEST_MAIN(TestCompactWriter)
+
+#include "tst_compactwriter.moc"
@@ -0,0 +1,14 @@
+include(../tests.pri)
+
+TARGET = tst_compactwriter
+
+SOURCES += \
+    tst_compactwriter.cpp \
+    $$ROOT/sources/compactwriter.cpp \
+    $$ROOT/sources/incrementalwriter.cpp \
+    $$ROOT/sources/tools.cpp
+
+HEADERS += \
+    $$ROOT/headers/compactwriter.h \
+    $$ROOT/headers/incrementalwriter.h \
+    $$ROOT/headers/tools.h
@@ -0,0 +1,149 @@
+#include "editjournal.h"
+#include "editmodel.h"
+#include "testdocument.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QFont>
+#include <QPointF>
+#include <QTemporaryDir>
+#include <QtTest>
+
+class TestEditJournal : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void replayRestoresEdits();
+    void replayIgnoresTornRecord();
+    void replayIgnoresBadChecksum();
+    void staleJournalIsIgnored();
+
+private:
+    // 在 m_fileName 上编辑第一页的第一段文本并写入日志
+    void writeJournal(const QString &text);
+    static void appendRaw(const QString &fileName, const QByteArray &data);
+
+    QTemporaryDir m_dir;
+    QString m_fileName;
+    QString m_original;
+};
+
+void TestEditJournal::init()
+{
+    QVERIFY(m_dir.isValid());
+    m_fileName = m_dir.filePath("journal.pdf");
+    QFile file(m_fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(CreateTestDocument());
+    file.close();
+    QFile::remove(EditJournal::journalFileName(m_fileName));
+
+    EditModel model;
+    model.load(m_fileName);
+    QVERIFY(!model.pageRuns(0).isEmpty());
+    m_original = model.run({ 0, 0 }).run.text;
+}
+
+void TestEditJournal::writeJournal(const QString &text)
+{
+    EditModel model;
+    model.load(m_fileName);
+    model.pageRuns(0);
+    EditJournal journal(&model);
+    QVERIFY(journal.start());
+    model.setText({ 0, 0 }, text);
+    journal.flush();
+    // 模拟崩溃：不调用 stop()，日志留在磁盘上
+}
+
+void TestEditJournal::appendRaw(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Append));
+    file.write(data);
+}
+
+void TestEditJournal::replayRestoresEdits()
+{
+    writeJournal("Edited");
+    QVERIFY(EditJournal::isRecoverable(m_fileName));
+
+    EditModel model;
+    model.load(m_fileName);
+    EditJournal journal(&model);
+    QCOMPARE(journal.replay(), 1);
+    QCOMPARE(model.run({ 0, 0 }).run.text, QString("Edited"));
+    // 恢复的修改可以撤销
+    model.undoStack()->undo();
+    QCOMPARE(model.run({ 0, 0 }).run.text, m_original);
+}
+
+void TestEditJournal::replayIgnoresTornRecord()
+{
+    writeJournal("Edited");
+
+    // 崩溃时写了一半的记录：长度超过文件剩余的内容
+    QByteArray torn;
+    {
+        QDataStream out(&torn, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_15);
+        out << quint32(1000) << quint16(0);
+        out.writeRawData("partial", 7);
+    }
+    appendRaw(EditJournal::journalFileName(m_fileName), torn);
+
+    EditModel model;
+    model.load(m_fileName);
+    EditJournal journal(&model);
+    QCOMPARE(journal.replay(), 1);
+    QCOMPARE(model.run({ 0, 0 }).run.text, QString("Edited"));
+}
+
+void TestEditJournal::replayIgnoresBadChecksum()
+{
+    writeJournal("Edited");
+
+    // 长度完整但内容损坏的记录及其之后的内容都被忽略
+    QByteArray payload;
+    {
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_15);
+        out << qint32(0) << qint32(0) << QString("Corrupted") << QPointF() << QFont();
+    }
+    QByteArray record;
+    {
+        QDataStream out(&record, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_15);
+        out << quint32(payload.size()) << quint16(qChecksum(payload.constData(), uint(payload.size())) ^ 0xFFFF);
+        out.writeRawData(payload.constData(), payload.size());
+    }
+    appendRaw(EditJournal::journalFileName(m_fileName), record);
+
+    EditModel model;
+    model.load(m_fileName);
+    EditJournal journal(&model);
+    QCOMPARE(journal.replay(), 1);
+    QCOMPARE(model.run({ 0, 0 }).run.text, QString("Edited"));
+}
+
+void TestEditJournal::staleJournalIsIgnored()
+{
+    writeJournal("Edited");
+
+    // 原文件在日志之外被修改，日志作废
+    appendRaw(m_fileName, "\n% modified\n");
+    QVERIFY(!EditJournal::isRecoverable(m_fileName));
+
+    EditModel model;
+    model.load(m_fileName);
+    EditJournal journal(&model);
+    QCOMPARE(journal.replay(), 0);
+    QCOMPARE(model.run({ 0, 0 }).run.text, m_original);
+}
+
+QTEST_MAIN(TestEditJournal)
+
+#include "tst_editjournal.moc"
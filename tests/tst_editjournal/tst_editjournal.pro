@@ -0,0 +1,11 @@
+include(../tests.pri)
+include(../editmodel.pri)
+
+TARGET = tst_editjournal
+
+SOURCES += \
+    tst_editjournal.cpp \
+    $$ROOT/sources/editjournal.cpp
+
+HEADERS += \
+    $$ROOT/headers/editjournal.h
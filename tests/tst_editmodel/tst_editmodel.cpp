@@ -0,0 +1,121 @@
+#include "editmodel.h"
+#include "testdocument.h"
+
+#include <QFile>
+#include <QFont>
+#include <QPointF>
+#include <QTemporaryDir>
+#include <QUndoStack>
+#include <QtTest>
+
+class TestEditModel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+
+    void typingMergesIntoOneStep();
+    void backspaceMergesIntoOneStep();
+    void separateEditsDoNotMerge();
+    void dragMergesIntoOneStep();
+    void fontChangesDoNotMerge();
+
+private:
+    QString text() const { return m_model.run(Index).run.text; }
+
+    static const EditRunIndex Index;
+    QTemporaryDir m_dir;
+    QString m_fileName;
+    EditModel m_model;
+    QString m_original;
+};
+
+const EditRunIndex TestEditModel::Index(0, 0);
+
+void TestEditModel::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    m_fileName = m_dir.filePath("model.pdf");
+    QFile file(m_fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(CreateTestDocument(1));
+}
+
+void TestEditModel::init()
+{
+    m_model.load(m_fileName);
+    QVERIFY(!m_model.pageRuns(0).isEmpty());
+    m_original = text();
+}
+
+void TestEditModel::typingMergesIntoOneStep()
+{
+    // 连续输入只占一步，撤销后回到输入前
+    m_model.setText(Index, m_original + "a");
+    m_model.setText(Index, m_original + "ab");
+    m_model.setText(Index, m_original + "abc");
+    QCOMPARE(m_model.undoStack()->count(), 1);
+    m_model.undoStack()->undo();
+    QCOMPARE(text(), m_original);
+    m_model.undoStack()->redo();
+    QCOMPARE(text(), m_original + "abc");
+}
+
+void TestEditModel::backspaceMergesIntoOneStep()
+{
+    m_model.setText(Index, m_original.left(m_original.length() - 1));
+    m_model.setText(Index, m_original.left(m_original.length() - 2));
+    QCOMPARE(m_model.undoStack()->count(), 1);
+    m_model.undoStack()->undo();
+    QCOMPARE(text(), m_original);
+}
+
+void TestEditModel::separateEditsDoNotMerge()
+{
+    // 在不相邻的位置输入是两步
+    m_model.setText(Index, m_original + "a");
+    m_model.setText(Index, "b" + m_original + "a");
+    QCOMPARE(m_model.undoStack()->count(), 2);
+    m_model.undoStack()->undo();
+    QCOMPARE(text(), m_original + "a");
+}
+
+void TestEditModel::dragMergesIntoOneStep()
+{
+    const QPointF origin = m_model.run(Index).run.pos;
+    const int gesture = m_model.beginGesture();
+    m_model.setPos(Index, origin + QPointF(1, 0), gesture);
+    m_model.setPos(Index, origin + QPointF(2, 0), gesture);
+    m_model.setPos(Index, origin + QPointF(3, 0), gesture);
+    QCOMPARE(m_model.undoStack()->count(), 1);
+
+    // 下一次拖动和不属于拖动的移动都单独一步
+    const int next = m_model.beginGesture();
+    QVERIFY(next != gesture);
+    m_model.setPos(Index, origin + QPointF(4, 0), next);
+    m_model.setPos(Index, origin + QPointF(5, 0));
+    m_model.setPos(Index, origin + QPointF(6, 0));
+    QCOMPARE(m_model.undoStack()->count(), 4);
+
+    m_model.undoStack()->setIndex(0);
+    QCOMPARE(m_model.run(Index).run.pos, origin);
+}
+
+void TestEditModel::fontChangesDoNotMerge()
+{
+    QFont font = m_model.run(Index).run.font;
+    const QFont original = font;
+    font.setPointSizeF(font.pointSizeF() + 1);
+    m_model.setFont(Index, font);
+    font.setPointSizeF(font.pointSizeF() + 1);
+    m_model.setFont(Index, font);
+    QCOMPARE(m_model.undoStack()->count(), 2);
+    m_model.undoStack()->setIndex(0);
+    QCOMPARE(m_model.run(Index).run.font, original);
+}
+
+QTEST_MAIN(TestEditModel)
+
+#include "tst_editmodel.moc"
@@ -0,0 +1,7 @@
+include(../tests.pri)
+include(../editmodel.pri)
+
+TARGET = tst_editmodel
+
+SOURCES += \
+    tst_editmodel.cpp
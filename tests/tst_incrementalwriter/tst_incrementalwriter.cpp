@@ -0,0 +1,144 @@
+#include "incrementalwriter.h"
+#include "qiodevicestream.h"
+#include "testdocument.h"
+#include "tools.h"
+
+#include <QBuffer>
+#include <QTemporaryFile>
+#include <QtTest>
+
+using namespace PoDoFo;
+
+class TestIncrementalWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void writeKeepsOriginal();
+    void writeReplacesAndAddsObjects();
+    void appendMatchesWrite();
+
+private:
+    // 修改第一页的字典并新增一个压缩的流，返回新流的编号
+    PdfReference addChanges(IncrementalWriter &writer);
+    static uint32_t TrailerSize(PdfMemDocument &document);
+
+    QByteArray m_source;
+    PdfMemDocument m_document;
+};
+
+void TestIncrementalWriter::init()
+{
+    m_source = CreateTestDocument();
+    LoadDocument(m_document, m_source);
+}
+
+uint32_t TestIncrementalWriter::TrailerSize(PdfMemDocument &document)
+{
+    return uint32_t(document.GetTrailer().GetDictionary().MustFindKey("Size").GetNumber());
+}
+
+PdfReference TestIncrementalWriter::addChanges(IncrementalWriter &writer)
+{
+    PdfPage& page = m_document.GetPages().GetPageAt(0);
+    PdfObject dictionary(page.GetDictionary());
+    dictionary.GetDictionary().AddKey("UPdfTest", PdfObject(true));
+    writer.setObject(page.GetObject().GetIndirectReference(), dictionary);
+
+    const PdfReference ref = writer.createObject();
+    PdfDictionary streamDictionary;
+    streamDictionary.AddKey("Filter", PdfName("FlateDecode"));
+    writer.setStream(ref, streamDictionary, UPdfDeflate("BT /F1 12 Tf (added) Tj ET", -1));
+    return ref;
+}
+
+void TestIncrementalWriter::writeKeepsOriginal()
+{
+    IncrementalWriter writer(m_document.GetTrailer().GetDictionary(), TrailerSize(m_document));
+    QBuffer source(&m_source);
+    source.open(QIODevice::ReadOnly);
+    charbuff buffer;
+    {
+        BufferStreamDevice device(buffer);
+        writer.write(source, device);
+    }
+    const QByteArray output = ToByteArray(buffer);
+
+    // 原文件原样保留在开头，没有修改时追加的更新不影响任何对象
+    QVERIFY(output.startsWith(m_source));
+    PdfMemDocument reloaded;
+    LoadDocument(reloaded, output);
+    QCOMPARE(reloaded.GetPages().GetCount(), m_document.GetPages().GetCount());
+    for (const PdfObject* object : m_document.GetObjects()) {
+        const PdfObject* copy = reloaded.GetObjects().GetObject(object->GetIndirectReference());
+        QVERIFY(copy != nullptr);
+        QCOMPARE(ObjectContent(*copy), ObjectContent(*object));
+    }
+}
+
+void TestIncrementalWriter::writeReplacesAndAddsObjects()
+{
+    IncrementalWriter writer(m_document.GetTrailer().GetDictionary(), TrailerSize(m_document));
+    const PdfReference added = addChanges(writer);
+    QCOMPARE(added.ObjectNumber(), TrailerSize(m_document));
+
+    QBuffer source(&m_source);
+    source.open(QIODevice::ReadOnly);
+    charbuff buffer;
+    {
+        BufferStreamDevice device(buffer);
+        writer.write(source, device);
+    }
+    PdfMemDocument reloaded;
+    LoadDocument(reloaded, ToByteArray(buffer));
+
+    // 替换的页面字典生效，其余对象不变
+    const PdfReference pageRef = m_document.GetPages().GetPageAt(0).GetObject().GetIndirectReference();
+    QVERIFY(reloaded.GetPages().GetPageAt(0).GetDictionary().HasKey("UPdfTest"));
+    for (const PdfObject* object : m_document.GetObjects()) {
+        if (object->GetIndirectReference() == pageRef)
+            continue;
+        const PdfObject* copy = reloaded.GetObjects().GetObject(object->GetIndirectReference());
+        QVERIFY(copy != nullptr);
+        QCOMPARE(ObjectContent(*copy), ObjectContent(*object));
+    }
+    QCOMPARE(PageContents(reloaded, 0), PageContents(m_document, 0));
+    QCOMPARE(PageContents(reloaded, 1), PageContents(m_document, 1));
+
+    // 新的流按 /Filter 解码
+    const PdfObject* stream = reloaded.GetObjects().GetObject(added);
+    QVERIFY(stream != nullptr && stream->HasStream());
+    QCOMPARE(ToByteArray(stream->GetStream()->GetCopy()), QByteArray("BT /F1 12 Tf (added) Tj ET"));
+    QCOMPARE(uint32_t(reloaded.GetTrailer().GetDictionary().MustFindKey("Size").GetNumber()), writer.size());
+}
+
+void TestIncrementalWriter::appendMatchesWrite()
+{
+    IncrementalWriter copied(m_document.GetTrailer().GetDictionary(), TrailerSize(m_document));
+    addChanges(copied);
+    QBuffer source(&m_source);
+    source.open(QIODevice::ReadOnly);
+    charbuff expected;
+    {
+        BufferStreamDevice device(expected);
+        copied.write(source, device);
+    }
+
+    // 直接追加到原文件与复制原文件后追加的结果相同
+    IncrementalWriter appended(m_document.GetTrailer().GetDictionary(), TrailerSize(m_document));
+    addChanges(appended);
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write(m_source);
+    QIODeviceOutputStream device(file);
+    appended.append(file, device);
+    file.flush();
+    file.seek(0);
+    QCOMPARE(file.readAll(), ToByteArray(expected));
+}
+
+QTEST_MAIN(TestIncrementalWriter)
+
+#include "tst_incrementalwriter.moc"
@@ -0,0 +1,14 @@
+include(../tests.pri)
+
+TARGET = tst_incrementalwriter
+
+SOURCES += \
+    tst_incrementalwriter.cpp \
+    $$ROOT/sources/incrementalwriter.cpp \
+    $$ROOT/sources/qiodevicestream.cpp \
+    $$ROOT/sources/tools.cpp
+
+HEADERS += \
+    $$ROOT/headers/incrementalwriter.h \
+    $$ROOT/headers/qiodevicestream.h \
+    $$ROOT/headers/tools.h
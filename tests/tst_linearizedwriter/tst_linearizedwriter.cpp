@@ -0,0 +1,66 @@
+#include "linearizedwriter.h"
+#include "testdocument.h"
+
+#include <QRegularExpression>
+#include <QtTest>
+
+using namespace PoDoFo;
+
+class TestLinearizedWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void deterministicId();
+
+private:
+    static QByteArray WriteLinearized(const QByteArray &source, bool deterministic = false);
+};
+
+QByteArray TestLinearizedWriter::WriteLinearized(const QByteArray &source, bool deterministic)
+{
+    PdfMemDocument document;
+    LoadDocument(document, source);
+    LinearizedWriter writer(document);
+    writer.setDeterministicId(deterministic);
+    charbuff buffer;
+    {
+        BufferStreamDevice device(buffer);
+        writer.write(device);
+    }
+    return ToByteArray(buffer);
+}
+
+void TestLinearizedWriter::roundTrip()
+{
+    const QByteArray source = CreateTestDocument(3);
+    const QByteArray output = WriteLinearized(source);
+
+    // 线性化字典是文件中的第一个对象，/L 为文件的长度
+    const QByteArray head = output.left(1024);
+    QVERIFY(head.contains("/Linearized"));
+    const QRegularExpressionMatch length = QRegularExpression("/L (\\d+)").match(QString::fromLatin1(head));
+    QVERIFY(length.hasMatch());
+    QCOMPARE(length.captured(1).toLongLong(), qint64(output.size()));
+
+    // 页面内容和字体不变
+    PdfMemDocument original;
+    LoadDocument(original, source);
+    PdfMemDocument reloaded;
+    LoadDocument(reloaded, output);
+    QCOMPARE(reloaded.GetPages().GetCount(), original.GetPages().GetCount());
+    for (unsigned i=0; i<original.GetPages().GetCount(); i++)
+        QCOMPARE(PageContents(reloaded, i), PageContents(original, i));
+    QCOMPARE(FontNames(reloaded), FontNames(original));
+}
+
+void TestLinearizedWriter::deterministicId()
+{
+    const QByteArray source = CreateTestDocument();
+    QCOMPARE(WriteLinearized(source, true), WriteLinearized(source, true));
+}
+
+QTEST_MAIN(TestLinearizedWriter)
+
+#include "tst_linearizedwriter.moc"
@@ -0,0 +1,12 @@
+include(../tests.pri)
+
+TARGET = tst_linearizedwriter
+
+SOURCES += \
+    tst_linearizedwriter.cpp \
+    $$ROOT/sources/linearizedwriter.cpp \
+    $$ROOT/sources/tools.cpp
+
+HEADERS += \
+    $$ROOT/headers/linearizedwriter.h \
+    $$ROOT/headers/tools.h
@@ -0,0 +1,116 @@
+#include "pageimagecache.h"
+#include "testdocument.h"
+
+#include <QBuffer>
+#include <QPdfDocument>
+#include <QSignalSpy>
+#include <QtTest>
+
+using Rotation = QPdfDocumentRenderOptions::Rotation;
+
+// 300x300 的 ARGB32 图片约 352 KB，1 MB 的缓存正好放下两张
+static const QSize ImageSize(300, 300);
+
+class TestPageImageCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+
+    void hitAfterRender();
+    void evictsLeastRecentlyUsed();
+    void closestImageKeepsLruOrder();
+    void clearDropsImages();
+
+private:
+    // 未命中时等待渲染完成，返回缓存中的图片
+    QImage render(int page, qreal zoom = 1.0);
+    bool cached(int page, qreal zoom = 1.0);
+
+    QByteArray m_data;
+    QBuffer m_buffer;
+    QPdfDocument m_document;
+    PageImageCache m_cache;
+};
+
+void TestPageImageCache::initTestCase()
+{
+    m_data = CreateTestDocument(3);
+    m_buffer.setData(m_data);
+    QVERIFY(m_buffer.open(QIODevice::ReadOnly));
+    m_document.load(&m_buffer);
+    QTRY_COMPARE(m_document.status(), QPdfDocument::Ready);
+    m_cache.setDocument(&m_document);
+}
+
+void TestPageImageCache::init()
+{
+    m_cache.clear();
+    m_cache.setBudget(1);
+    m_cache.resetStatistics();
+}
+
+QImage TestPageImageCache::render(int page, qreal zoom)
+{
+    QImage image = m_cache.image(page, zoom, 1.0, Rotation::None, ImageSize);
+    if (!image.isNull())
+        return image;
+    QSignalSpy ready(&m_cache, &PageImageCache::pageReady);
+    if (!ready.wait(5000))
+        return QImage();
+    return m_cache.image(page, zoom, 1.0, Rotation::None, ImageSize);
+}
+
+bool TestPageImageCache::cached(int page, qreal zoom)
+{
+    // 命中次数增加说明图片仍在缓存中
+    const int hits = m_cache.hitCount();
+    m_cache.image(page, zoom, 1.0, Rotation::None, ImageSize);
+    return m_cache.hitCount() > hits;
+}
+
+void TestPageImageCache::hitAfterRender()
+{
+    QVERIFY(!render(0).isNull());
+    QCOMPARE(m_cache.missCount(), 1);
+    QCOMPARE(m_cache.hitCount(), 1);
+    QVERIFY(m_cache.cachedBytes() <= qint64(m_cache.budget()) * 1024 * 1024);
+}
+
+void TestPageImageCache::evictsLeastRecentlyUsed()
+{
+    QVERIFY(!render(0).isNull());
+    QVERIFY(!render(1).isNull());
+    // 访问第 0 页后，第 1 页成为最久未使用的
+    QVERIFY(cached(0));
+    QVERIFY(!render(2).isNull());
+    QVERIFY(m_cache.cachedBytes() <= qint64(m_cache.budget()) * 1024 * 1024);
+    QVERIFY(cached(0));
+    QVERIFY(cached(2));
+    QVERIFY(!cached(1));
+}
+
+void TestPageImageCache::closestImageKeepsLruOrder()
+{
+    QVERIFY(!render(0).isNull());
+    QVERIFY(!render(1).isNull());
+    // closestImage() 不改变 LRU 顺序，第 0 页仍是最久未使用的
+    QVERIFY(!m_cache.closestImage(0, 2.0, 1.0, Rotation::None).isNull());
+    QVERIFY(!render(2).isNull());
+    QVERIFY(!cached(0));
+    QVERIFY(cached(1));
+}
+
+void TestPageImageCache::clearDropsImages()
+{
+    QVERIFY(!render(0).isNull());
+    m_cache.clear();
+    QCOMPARE(m_cache.cachedBytes(), qint64(0));
+    QVERIFY(m_cache.closestImage(0, 1.0, 1.0, Rotation::None).isNull());
+}
+
+QTEST_MAIN(TestPageImageCache)
+
+#include "tst_pageimagecache.moc"
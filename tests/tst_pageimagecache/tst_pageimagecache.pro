@@ -0,0 +1,12 @@
+include(../tests.pri)
+
+QT += pdf
+
+TARGET = tst_pageimagecache
+
+SOURCES += \
+    tst_pageimagecache.cpp \
+    $$ROOT/sources/pageimagecache.cpp
+
+HEADERS += \
+    $$ROOT/headers/pageimagecache.h
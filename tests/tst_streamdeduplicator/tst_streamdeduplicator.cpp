@@ -0,0 +1,96 @@
+#include "streamdeduplicator.h"
+#include "testdocument.h"
+
+#include <QtTest>
+
+using namespace PoDoFo;
+
+// 两页引用的表单内容相同
+static const char FormData[] = "0 0 m 10 10 l S";
+
+class TestStreamDeduplicator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void mergesIdenticalStreams();
+    void keepsPageContents();
+
+private:
+    PdfReference pageForm(unsigned pageIndex);
+
+    PdfMemDocument m_document;
+    PdfReference m_forms[2];
+};
+
+void TestStreamDeduplicator::init()
+{
+    LoadDocument(m_document, CreateTestDocument(2));
+    for (unsigned i=0; i<2; i++) {
+        PdfObject& form = m_document.GetObjects().CreateDictionaryObject("XObject", "Form");
+        PdfArray bbox;
+        for (int value : { 0, 0, 10, 10 })
+            bbox.Add(PdfObject(int64_t(value)));
+        form.GetDictionary().AddKey("BBox", bbox);
+        form.GetOrCreateStream().SetData(bufferview(FormData, sizeof(FormData) - 1));
+        m_forms[i] = form.GetIndirectReference();
+
+        PdfDictionary xobjects;
+        xobjects.AddKey("Fm1", PdfObject(m_forms[i]));
+        PdfPage& page = m_document.GetPages().GetPageAt(i);
+        page.GetDictionary().MustFindKeyParent("Resources").GetDictionary().AddKey("XObject", xobjects);
+    }
+}
+
+PdfReference TestStreamDeduplicator::pageForm(unsigned pageIndex)
+{
+    const PdfDictionary& resources = m_document.GetPages().GetPageAt(pageIndex).GetDictionary()
+            .MustFindKeyParent("Resources").GetDictionary();
+    return resources.MustFindKey("XObject").GetDictionary().MustGetKey("Fm1").GetReference();
+}
+
+void TestStreamDeduplicator::mergesIdenticalStreams()
+{
+    StreamDeduplicator deduplicator(m_document);
+    QVERIFY(deduplicator.run() >= 1);
+
+    // 两页引用同一个表单，另一个被删除
+    QCOMPARE(pageForm(0), pageForm(1));
+    const PdfReference removed = pageForm(0) == m_forms[0] ? m_forms[1] : m_forms[0];
+    QVERIFY(m_document.GetObjects().GetObject(removed) == nullptr);
+    QVERIFY(deduplicator.savedBytes().value("Form") > 0);
+
+    // 写出后重新读取，表单内容不变
+    charbuff buffer;
+    {
+        BufferStreamDevice device(buffer);
+        m_document.Save(device);
+    }
+    PdfMemDocument reloaded;
+    LoadDocument(reloaded, ToByteArray(buffer));
+    const PdfObject* form = reloaded.GetObjects().GetObject(pageForm(0));
+    QVERIFY(form != nullptr && form->HasStream());
+    QCOMPARE(ToByteArray(form->GetStream()->GetCopy()), QByteArray(FormData));
+}
+
+void TestStreamDeduplicator::keepsPageContents()
+{
+    // 两页的内容流相同也不合并，否则修改一页会影响另一页
+    PdfObject& first = m_document.GetPages().GetPageAt(0).GetDictionary().MustFindKey("Contents");
+    PdfObject& second = m_document.GetPages().GetPageAt(1).GetDictionary().MustFindKey("Contents");
+    QVERIFY(first.HasStream() && second.HasStream());
+    const charbuff contents = first.GetStream()->GetCopy();
+    second.GetOrCreateStream().SetData(contents);
+
+    StreamDeduplicator deduplicator(m_document);
+    deduplicator.run();
+    QVERIFY(m_document.GetObjects().GetObject(first.GetIndirectReference()) != nullptr);
+    QVERIFY(m_document.GetObjects().GetObject(second.GetIndirectReference()) != nullptr);
+    QCOMPARE(PageContents(m_document, 0), PageContents(m_document, 1));
+}
+
+QTEST_MAIN(TestStreamDeduplicator)
+
+#include "tst_streamdeduplicator.moc"
@@ -0,0 +1,12 @@
+include(../tests.pri)
+
+TARGET = tst_streamdeduplicator
+
+SOURCES += \
+    tst_streamdeduplicator.cpp \
+    $$ROOT/sources/streamdeduplicator.cpp \
+    $$ROOT/sources/tools.cpp
+
+HEADERS += \
+    $$ROOT/headers/streamdeduplicator.h \
+    $$ROOT/headers/tools.h